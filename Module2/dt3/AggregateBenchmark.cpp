@@ -0,0 +1,114 @@
+// ----------------------------------------------------------------------------
+// File:        AggregateBenchmark.cpp
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Benchmark of totalling cars per (id, hour) with the thread
+//              local open addressing tables in HashAggregate.h, against one
+//              std::unordered_map, on generated records with a large number
+//              of distinct lights (1,000,000 by default, each with a record
+//              every 15 minutes of one hour).
+//
+//              Every run's number of keys and total cars are checked against
+//              the std::unordered_map result.
+//
+//              Usage: ./aggregate_benchmark [lights] [max threads]
+//
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <unordered_map>
+#include <iomanip>
+#include <unistd.h>
+
+#include "TrafficData.h"
+#include "HashAggregate.h"
+
+using namespace std::chrono;
+using namespace std;
+
+const long NUM_CORES = sysconf(_SC_NPROCESSORS_ONLN);
+
+// Makes 4 records (one per 15 minutes) for each light in a random hour,
+// shuffled so a light's records aren't next to each other.
+vector<TrafficLightRecord> generateRecords(int num_lights) {
+    mt19937 rng(315);
+    uniform_int_distribution<int> random_hr(0, HOURS_PER_DAY - 1);
+    uniform_int_distribution<int> random_cars(0, 100000);
+
+    vector<TrafficLightRecord> records;
+    records.reserve(4 * static_cast<size_t>(num_lights));
+
+    for (int id = 0; id < num_lights; id++) {
+        int hr = random_hr(rng);
+        for (int quarter = 0; quarter < 4; quarter++) {
+            TrafficLightRecord record = {hr * 100 + quarter * 15, id, random_cars(rng)};
+            records.push_back(record);
+        }
+    }
+
+    shuffle(records.begin(), records.end(), rng);
+    return records;
+}
+
+int main(int argc, char *argv[]) {
+    int num_lights = (argc > 1) ? atoi(argv[1]) : 1000000;
+    int max_threads = (argc > 2) ? atoi(argv[2]) : 2 * NUM_CORES;
+
+    vector<TrafficLightRecord> records = generateRecords(num_lights);
+
+    auto start = high_resolution_clock::now();
+
+    unordered_map<uint64_t, long long> map_totals;
+    for (size_t i = 0; i < records.size(); i++) {
+        map_totals[aggregateKey(records[i].id, recordHour(records[i]))] += records[i].cars;
+    }
+
+    double map_seconds = duration_cast<duration<double>>(
+                            high_resolution_clock::now() - start).count();
+
+    long long expected_cars = 0;
+    for (unordered_map<uint64_t, long long>::iterator it = map_totals.begin();
+            it != map_totals.end(); it++) {
+        expected_cars += it->second;
+    }
+
+    cout << "records,keys,threads,unordered_map_records_per_s,"
+        << "open_addressing_records_per_s,speed_increase,matches\n";
+
+    for (int threads = 1; threads <= max(1, max_threads); threads *= 2) {
+        start = high_resolution_clock::now();
+
+        vector<AggregateTable> partitions;
+        aggregateRecords(records, threads, partitions);
+
+        double seconds = duration_cast<duration<double>>(
+                            high_resolution_clock::now() - start).count();
+
+        size_t keys = 0;
+        long long cars = 0;
+        for (size_t p = 0; p < partitions.size(); p++) {
+            keys += partitions[p].size;
+            for (size_t i = 0; i < partitions[p].slots.size(); i++) {
+                if (partitions[p].slots[i].key != AGGREGATE_EMPTY) {
+                    cars += partitions[p].slots[i].cars;
+                }
+            }
+        }
+
+        bool matches = (keys == map_totals.size() && cars == expected_cars);
+
+        cout << records.size() << "," << keys << "," << threads << ","
+            << fixed << setprecision(0) << records.size() / map_seconds << ","
+            << records.size() / seconds << ","
+            << setprecision(2) << map_seconds / seconds << ","
+            << (matches ? "yes" : "no") << "\n";
+    }
+
+    return EXIT_SUCCESS;
+}
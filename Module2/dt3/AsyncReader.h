@@ -0,0 +1,326 @@
+// ----------------------------------------------------------------------------
+// File:        AsyncReader.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Reads a file front to back in large chunks with several reads
+//              kept in flight through io_uring, so one thread can parse a
+//              chunk that has arrived while the kernel fetches the next
+//              ones. On a cold page cache the disk and the parser then work
+//              at the same time instead of taking turns.
+//
+//              io_uring is used through its raw system calls (no liburing).
+//              If the kernel doesn't have it, or won't let us use it, every
+//              chunk is read with a blocking pread() instead.
+//
+//              Each buffer has room in front of the data for the line the
+//              previous chunk ended part way through, so lines are never
+//              copied out to be joined. A line longer than that room is
+//              dropped, no real record comes close.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef ASYNC_READER_H
+#define ASYNC_READER_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const size_t ASYNC_READ_SIZE = 1 << 20;     // Bytes per read.
+const int ASYNC_READ_DEPTH = 4;             // Reads kept in flight.
+const size_t ASYNC_CARRY_ROOM = 4096;       // Room for a cut off line.
+
+struct AsyncReadSlot {
+    std::vector<char> buffer;       // ASYNC_CARRY_ROOM, then the data.
+    off_t offset;
+    size_t length;                  // Bytes asked for.
+    long result;                    // Bytes read, or -errno.
+    bool pending;                   // Submitted and not yet completed.
+    size_t carry;                   // Bytes of the last chunk's line in front.
+};
+
+// The mapped rings of an io_uring instance.
+struct AsyncRing {
+    int fd;
+    void *sq_ring, *cq_ring;
+    size_t sq_ring_size, cq_ring_size;
+    io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    io_uring_cqe *cqes;
+};
+
+struct AsyncReader {
+    int fd;
+    off_t file_size;
+    off_t next_offset;              // Where the next read submitted starts.
+    int next_slot;                  // The slot with the next chunk in file order.
+    bool use_uring;
+    AsyncRing ring;
+    AsyncReadSlot slots[ASYNC_READ_DEPTH];
+};
+
+// Sets up an io_uring with room for depth reads.
+//
+// Returns false if io_uring can't be used.
+inline bool setupAsyncRing(AsyncRing &ring, unsigned depth) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    ring.fd = syscall(__NR_io_uring_setup, depth, &params);
+    if (ring.fd < 0) {
+        return false;
+    }
+
+    ring.sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring.cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        ring.sq_ring_size = ring.cq_ring_size = std::max(ring.sq_ring_size, ring.cq_ring_size);
+    }
+
+    ring.sq_ring = mmap(nullptr, ring.sq_ring_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+    ring.cq_ring = single_mmap ? ring.sq_ring
+                    : mmap(nullptr, ring.cq_ring_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+    ring.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, ring.sqes_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+
+    if (ring.sq_ring == MAP_FAILED || ring.cq_ring == MAP_FAILED || sqes == MAP_FAILED) {
+        close(ring.fd);
+        return false;
+    }
+
+    char *sq = static_cast<char *>(ring.sq_ring);
+    char *cq = static_cast<char *>(ring.cq_ring);
+    ring.sqes = static_cast<io_uring_sqe *>(sqes);
+    ring.sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    ring.sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    ring.sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    ring.sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    ring.cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    ring.cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    ring.cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    ring.cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+}
+
+inline void destroyAsyncRing(AsyncRing &ring) {
+    munmap(ring.sqes, ring.sqes_size);
+    if (ring.cq_ring != ring.sq_ring) {
+        munmap(ring.cq_ring, ring.cq_ring_size);
+    }
+    munmap(ring.sq_ring, ring.sq_ring_size);
+    close(ring.fd);
+}
+
+// Reads all of a slot's chunk with pread(), picking up after a short read.
+inline void readSlot(AsyncReader &reader, AsyncReadSlot &slot, size_t already) {
+    char *data = slot.buffer.data() + ASYNC_CARRY_ROOM;
+    size_t done = already;
+
+    while (done < slot.length) {
+        ssize_t n = pread(reader.fd, data + done, slot.length - done, slot.offset + done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            slot.result = (n < 0) ? -errno : static_cast<long>(done);
+            return;
+        }
+        done += n;
+    }
+    slot.result = done;
+}
+
+// Starts reading the next chunk of the file into slot s, if there is one.
+inline void submitSlot(AsyncReader &reader, int s) {
+    AsyncReadSlot &slot = reader.slots[s];
+    if (reader.next_offset >= reader.file_size) {
+        slot.length = 0;
+        return;
+    }
+
+    slot.offset = reader.next_offset;
+    slot.length = std::min<off_t>(ASYNC_READ_SIZE, reader.file_size - reader.next_offset);
+    slot.pending = true;
+    reader.next_offset += slot.length;
+
+    if (!reader.use_uring) {
+        return;
+    }
+
+    AsyncRing &ring = reader.ring;
+    unsigned tail = __atomic_load_n(ring.sq_tail, __ATOMIC_ACQUIRE);
+    unsigned index = tail & *ring.sq_mask;
+
+    io_uring_sqe *sqe = &ring.sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = reader.fd;
+    sqe->addr = reinterpret_cast<unsigned long>(slot.buffer.data() + ASYNC_CARRY_ROOM);
+    sqe->len = slot.length;
+    sqe->off = slot.offset;
+    sqe->user_data = s;
+
+    ring.sq_array[index] = index;
+    __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    while (syscall(__NR_io_uring_enter, ring.fd, 1, 0, 0, nullptr, 0) < 0) {
+        // The kernel only takes entries inside io_uring_enter(), so if the
+        // head hasn't passed this one it is still ours.
+        if (__atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE) != tail) {
+            return;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+
+        // Taken back out of the ring so a later submit can't send it, and
+        // read with pread() instead.
+        __atomic_store_n(ring.sq_tail, tail, __ATOMIC_RELEASE);
+        readSlot(reader, slot, 0);
+        slot.pending = false;
+        return;
+    }
+}
+
+// Waits until slot s's read has completed, taking any other completions
+// that arrive first.
+inline void waitForSlot(AsyncReader &reader, int s) {
+    AsyncReadSlot &slot = reader.slots[s];
+
+    if (!reader.use_uring) {
+        readSlot(reader, slot, 0);
+        slot.pending = false;
+        return;
+    }
+
+    AsyncRing &ring = reader.ring;
+    while (slot.pending) {
+        unsigned head = *ring.cq_head;
+        if (head == __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE)) {
+            syscall(__NR_io_uring_enter, ring.fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            continue;
+        }
+
+        const io_uring_cqe &cqe = ring.cqes[head & *ring.cq_mask];
+        AsyncReadSlot &done = reader.slots[cqe.user_data];
+        done.result = cqe.res;
+        done.pending = false;
+        __atomic_store_n(ring.cq_head, head + 1, __ATOMIC_RELEASE);
+
+        // A short read (or one the kernel turned down) is finished off
+        // with pread() so the chunk is always whole.
+        if (done.result >= 0 && static_cast<size_t>(done.result) < done.length) {
+            readSlot(reader, done, done.result);
+        }
+        else if (done.result < 0) {
+            readSlot(reader, done, 0);
+        }
+    }
+}
+
+// Opens path and starts the first ASYNC_READ_DEPTH reads.
+//
+// Returns false if the file can't be opened.
+inline bool openAsyncReader(AsyncReader &reader, const char *path) {
+    reader.fd = open(path, O_RDONLY);
+    struct stat info;
+    if (reader.fd == -1 || fstat(reader.fd, &info) != 0) {
+        if (reader.fd != -1) {
+            close(reader.fd);
+        }
+        return false;
+    }
+    posix_fadvise(reader.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    reader.file_size = info.st_size;
+    reader.next_offset = 0;
+    reader.next_slot = 0;
+    reader.use_uring = setupAsyncRing(reader.ring, ASYNC_READ_DEPTH);
+
+    for (int s = 0; s < ASYNC_READ_DEPTH; s++) {
+        reader.slots[s].buffer.resize(ASYNC_CARRY_ROOM + ASYNC_READ_SIZE);
+        reader.slots[s].pending = false;
+        reader.slots[s].carry = 0;
+        submitSlot(reader, s);
+    }
+    return true;
+}
+
+// Waits for the next chunk in file order and sets [begin, end) to it, with
+// the line the last chunk ended part way through in front. at_eof is set
+// for the file's last chunk.
+//
+// Returns false once the whole file has been returned, or if a read fails
+// (then error is set to the errno).
+inline bool nextChunk(AsyncReader &reader, const char *&begin, const char *&end, bool &at_eof,
+                        int &error) {
+    AsyncReadSlot &slot = reader.slots[reader.next_slot];
+    error = 0;
+    if (slot.length == 0) {
+        return false;
+    }
+
+    waitForSlot(reader, reader.next_slot);
+    if (slot.result < 0) {
+        error = -slot.result;
+        return false;
+    }
+
+    const char *data = slot.buffer.data() + ASYNC_CARRY_ROOM;
+    begin = data - slot.carry;
+    end = data + slot.result;
+    at_eof = (slot.offset + static_cast<off_t>(slot.result) >= reader.file_size);
+    return true;
+}
+
+// Hands back the chunk from nextChunk(). [rest, end) is kept for the front
+// of the next chunk, then the buffer is reused for the next read.
+inline void finishChunk(AsyncReader &reader, const char *rest, const char *end) {
+    int s = reader.next_slot;
+    int next = (s + 1) % ASYNC_READ_DEPTH;
+    AsyncReadSlot &following = reader.slots[next];
+
+    // The following slot's read goes after its carry room, so this can be
+    // written while it is still in flight.
+    size_t carry = end - rest;
+    following.carry = (carry <= ASYNC_CARRY_ROOM) ? carry : 0;
+    memcpy(following.buffer.data() + ASYNC_CARRY_ROOM - following.carry, rest, following.carry);
+
+    reader.slots[s].carry = 0;
+    submitSlot(reader, s);
+    reader.next_slot = next;
+}
+
+inline void closeAsyncReader(AsyncReader &reader) {
+    // Reads still in flight write into the buffers, so they are waited for
+    // before anything is freed.
+    for (int s = 0; s < ASYNC_READ_DEPTH; s++) {
+        if (reader.slots[s].pending) {
+            waitForSlot(reader, s);
+        }
+    }
+
+    if (reader.use_uring) {
+        destroyAsyncRing(reader.ring);
+    }
+    close(reader.fd);
+}
+
+#endif
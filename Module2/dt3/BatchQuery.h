@@ -0,0 +1,166 @@
+// ----------------------------------------------------------------------------
+// File:        BatchQuery.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Answering many (N, hour) queries against one loaded dataset.
+//
+//              Queries for the same hour share one selection: the hour's
+//              records are ranked once for the largest N asked of it, and
+//              every query for that hour takes the last N of that. The
+//              selections for different hours are made in parallel.
+//
+//              A query file has one "N hr" pair per line, blank lines and
+//              lines starting with '#' are ignored.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef BATCH_QUERY_H
+#define BATCH_QUERY_H
+
+#include <atomic>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <pthread.h>
+#include <vector>
+#include <algorithm>
+
+#include "TrafficData.h"
+#include "HourIndex.h"
+
+struct TrafficQuery {
+    int N;
+    int hr;
+};
+
+// Data for the threads that make the per-hour selections.
+struct Select_ThreadData {
+    const HourIndex *index;
+    const int *max_N;
+    std::vector<TrafficLightRecord> *selections;
+    std::atomic<int> *next_hour;
+};
+
+// Parses an "N hr" line into query.
+//
+// Returns false if the line isn't two integers, N isn't positive or hr isn't
+// an hour of the day.
+inline bool parseQueryLine(const std::string &line, TrafficQuery &query) {
+    std::istringstream line_stream(line);
+    std::string rest;
+
+    return (line_stream >> query.N >> query.hr) && !(line_stream >> rest)
+            && query.N > 0 && query.hr >= 0 && query.hr < HOURS_PER_DAY;
+}
+
+// Reads every query from in, in order.
+//
+// Returns false (after printing the line number of each) if any line isn't a
+// valid query.
+inline bool readQueries(std::istream &in, std::vector<TrafficQuery> &queries) {
+    std::string line;
+    bool valid = true;
+
+    for (int line_number = 1; getline(in, line); line_number++) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+
+        TrafficQuery query;
+        if (parseQueryLine(line, query)) {
+            queries.push_back(query);
+        }
+        else {
+            std::cerr << "Bad query on line " << line_number << ": " << line << "\n";
+            valid = false;
+        }
+    }
+
+    return valid;
+}
+
+// Fills max_N with the largest N asked of each hour, 0 if it isn't queried.
+inline void maxNPerHour(const std::vector<TrafficQuery> &queries, int max_N[HOURS_PER_DAY]) {
+    std::fill(max_N, max_N + HOURS_PER_DAY, 0);
+
+    for (size_t i = 0; i < queries.size(); i++) {
+        max_N[queries[i].hr] = std::max(max_N[queries[i].hr], queries[i].N);
+    }
+}
+
+// Makes the selection for one hour, its top max_N records (or all of them if
+// it has fewer) in increasing order of cars.
+inline void selectHour(const HourIndex &index, int hr, int max_N,
+                        std::vector<TrafficLightRecord> &selection) {
+    int N = static_cast<int>(std::min(static_cast<size_t>(max_N), hourSize(index, hr)));
+    selection.clear();
+
+    if (N > 0) {
+        selection = mostCongestion(index, hr, N);
+    }
+}
+
+// Worker function for the selection threads, takes hours off a shared
+// counter until they have all been done.
+inline void *selectHours(void *arg) {
+    Select_ThreadData *data = static_cast<Select_ThreadData *>(arg);
+
+    int hr;
+    while ((hr = data->next_hour->fetch_add(1)) < HOURS_PER_DAY) {
+        if (data->max_N[hr] > 0) {
+            selectHour(*data->index, hr, data->max_N[hr], data->selections[hr]);
+        }
+    }
+
+    pthread_exit(nullptr);
+}
+
+// Makes the selection for every queried hour using num_threads threads.
+inline void selectQueriedHours(const HourIndex &index, const std::vector<TrafficQuery> &queries,
+                                int num_threads,
+                                std::vector<TrafficLightRecord> selections[HOURS_PER_DAY]) {
+    int max_N[HOURS_PER_DAY];
+    maxNPerHour(queries, max_N);
+
+    std::atomic<int> next_hour(0);
+    Select_ThreadData select_thread_data = {&index, max_N, selections, &next_hour};
+
+    std::vector<pthread_t> tid(std::max(1, std::min(num_threads, HOURS_PER_DAY)));
+    for (size_t i = 0; i < tid.size(); i++) {
+        pthread_create(&tid[i], nullptr, selectHours, &select_thread_data);
+    }
+
+    for (size_t i = 0; i < tid.size(); i++) {
+        pthread_join(tid[i], nullptr);
+    }
+}
+
+// Returns the answer to query from its hour's selection, the same as
+// mostCongestion() except that an hour with fewer than N records gives them
+// all.
+inline std::vector<TrafficLightRecord> answerQuery(
+        const std::vector<TrafficLightRecord> selections[HOURS_PER_DAY],
+        const TrafficQuery &query) {
+    const std::vector<TrafficLightRecord> &selection = selections[query.hr];
+    size_t N = std::min(static_cast<size_t>(query.N), selection.size());
+
+    return std::vector<TrafficLightRecord>(selection.end() - N, selection.end());
+}
+
+// Prints the answer to every query, in the order they were given.
+inline void printQueryAnswers(const std::vector<TrafficQuery> &queries,
+                                const std::vector<TrafficLightRecord> selections[HOURS_PER_DAY]) {
+    for (size_t i = 0; i < queries.size(); i++) {
+        std::vector<TrafficLightRecord> answer = answerQuery(selections, queries[i]);
+
+        std::cout << "Query " << i + 1 << ": N = " << queries[i].N
+            << ", hr = " << queries[i].hr << "\n\n";
+        printMostCongested(answer, answer.size());
+    }
+}
+
+#endif
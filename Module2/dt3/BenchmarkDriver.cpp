@@ -0,0 +1,459 @@
+// ----------------------------------------------------------------------------
+// File:        BenchmarkDriver.cpp
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Scaling benchmark of the simulators. Sweeps dataset sizes, and
+//              for the pthread engine thread counts, producer/consumer ratios,
+//              buffer sizes and channels, running ./sequential and ./threaded
+//              (from the driver's own directory) with --stats for each.
+//
+//              Datasets are made with ./generate_data. Each configuration is
+//              run repeats times and the run with the best ingest rate is
+//              kept. Its ingest records/s, query latency and lock wait come
+//              from the simulator's --stats line, its peak RSS from wait4().
+//
+//              A ratio p:c gives p / (p + c) of the threads to producers
+//              (rounded, at least 1) and the rest, at least 1, to consumers.
+//              The ratio "auto" runs with --producers=auto and reports the
+//              split the simulator chose. --pin is passed on to every
+//              threaded run.
+//
+//              The sequential engine runs once per --seq-inputs input
+//              (uring being its io_uring reader), or with --input if that
+//              isn't given. --cold drops the dataset from the page cache
+//              before every run, so reading it costs real disk I/O.
+//
+//              Usage: ./benchmark_driver [--threads=1,2,4] [--ratios=1:1,1:3,3:1,auto]
+//                                        [--buffers=100,1000] [--lights=1000,10000]
+//                                        [--channels=queue,ring]
+//                                        [--input=getline|mmap|partitioned]
+//                                        [--repeats=n] [--format=csv|json]
+//                                        [--work-dir=path] [--pin=spread|cores]
+//                                        [--seq-inputs=getline,mmap,uring] [--cold]
+//
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <iomanip>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "RunStats.h"
+
+using namespace std;
+
+const long NUM_CORES = sysconf(_SC_NPROCESSORS_ONLN);
+
+struct DriverOptions {
+    vector<int> threads;
+    vector<string> ratios = {"1:1"};
+    vector<int> buffers = {100};
+    vector<int> lights = {1000};
+    vector<string> channels = {"queue"};
+    string input = "mmap";
+    int repeats = 3;
+    string format = "csv";
+    string work_dir = "/tmp/traffic_benchmark";
+    string pin;                 // Empty for unpinned threads.
+    vector<string> seq_inputs;  // Empty for the --input one.
+    bool cold = false;
+};
+
+// One configuration's best run.
+struct BenchmarkResult {
+    string engine;
+    string input;
+    int lights;
+    int threads;
+    int producers;
+    int consumers;
+    int buffer;
+    string channel;
+    RunStats stats;
+    long peak_rss_kb;
+};
+
+vector<string> splitList(const string &list) {
+    vector<string> items;
+    stringstream stream(list);
+    string item;
+    while (getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// Parses a comma separated list of positive ints.
+//
+// Returns false if any item isn't one.
+bool parseIntList(const string &list, vector<int> &values) {
+    values.clear();
+    vector<string> items = splitList(list);
+    for (size_t i = 0; i < items.size(); i++) {
+        if (items[i].find_first_not_of("0123456789") != string::npos
+                || atoi(items[i].c_str()) < 1) {
+            return false;
+        }
+        values.push_back(atoi(items[i].c_str()));
+    }
+    return !values.empty();
+}
+
+bool parseRatio(const string &ratio, int &producer_share, int &consumer_share) {
+    return sscanf(ratio.c_str(), "%d:%d", &producer_share, &consumer_share) == 2
+            && producer_share > 0 && consumer_share > 0;
+}
+
+// Reads the --name=value options.
+//
+// Returns false (after printing why) if an option isn't recognised.
+bool parseOptions(int argc, char *argv[], DriverOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        size_t equals = arg.find('=');
+        string name = arg.substr(0, equals);
+        string value = (equals == string::npos) ? "" : arg.substr(equals + 1);
+        bool valid = true;
+
+        if (name == "--threads") {
+            valid = parseIntList(value, options.threads);
+        }
+        else if (name == "--ratios") {
+            options.ratios = splitList(value);
+            int p, c;
+            for (size_t r = 0; r < options.ratios.size(); r++) {
+                valid = valid && (options.ratios[r] == "auto"
+                                    || parseRatio(options.ratios[r], p, c));
+            }
+            valid = valid && !options.ratios.empty();
+        }
+        else if (name == "--buffers") {
+            valid = parseIntList(value, options.buffers);
+        }
+        else if (name == "--lights") {
+            valid = parseIntList(value, options.lights);
+        }
+        else if (name == "--channels") {
+            options.channels = splitList(value);
+            for (size_t c = 0; c < options.channels.size(); c++) {
+                valid = valid && (options.channels[c] == "queue" || options.channels[c] == "ring");
+            }
+            valid = valid && !options.channels.empty();
+        }
+        else if (name == "--input") {
+            options.input = value;
+            valid = (value == "getline" || value == "mmap" || value == "partitioned");
+        }
+        else if (name == "--repeats" && atoi(value.c_str()) > 0) {
+            options.repeats = atoi(value.c_str());
+        }
+        else if (name == "--format" && (value == "csv" || value == "json")) {
+            options.format = value;
+        }
+        else if (name == "--work-dir" && !value.empty()) {
+            options.work_dir = value;
+        }
+        else if (name == "--pin" && !value.empty()) {
+            // The simulator checks the cores, a bad list fails the first run.
+            options.pin = value;
+        }
+        else if (name == "--seq-inputs") {
+            options.seq_inputs = splitList(value);
+            for (size_t s = 0; s < options.seq_inputs.size(); s++) {
+                const string &input = options.seq_inputs[s];
+                valid = valid && (input == "getline" || input == "mmap" || input == "uring");
+            }
+            valid = valid && !options.seq_inputs.empty();
+        }
+        else if (name == "--cold" && equals == string::npos) {
+            options.cold = true;
+        }
+        else {
+            valid = false;
+        }
+
+        if (!valid) {
+            cerr << "Bad option: " << arg << "\n";
+            return false;
+        }
+    }
+
+    // The sequential engine has no partitioned input.
+    if (options.seq_inputs.empty()) {
+        options.seq_inputs.push_back((options.input == "partitioned") ? "mmap" : options.input);
+    }
+
+    // Powers of 2 up to twice the cores by default.
+    if (options.threads.empty()) {
+        for (int threads = 1; threads <= 2 * NUM_CORES; threads *= 2) {
+            options.threads.push_back(threads);
+        }
+    }
+
+    return true;
+}
+
+// Runs args[0] with stdout discarded, collecting its stderr and peak RSS.
+//
+// Returns false if it couldn't be run or didn't exit with success.
+bool runCommand(const vector<string> &args, string &errors, long &peak_rss_kb) {
+    int pipe_fds[2];
+    if (pipe(pipe_fds) == -1) {
+        return false;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(pipe_fds[1], STDERR_FILENO);
+        close(pipe_fds[0]);
+
+        vector<char *> argv;
+        for (size_t i = 0; i < args.size(); i++) {
+            argv.push_back(const_cast<char *>(args[i].c_str()));
+        }
+        argv.push_back(nullptr);
+
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    close(pipe_fds[1]);
+    errors.clear();
+    char chunk[4096];
+    ssize_t n;
+    while ((n = read(pipe_fds[0], chunk, sizeof(chunk))) > 0) {
+        errors.append(chunk, n);
+    }
+    close(pipe_fds[0]);
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) == -1) {
+        return false;
+    }
+
+    peak_rss_kb = usage.ru_maxrss;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Writes back and evicts path's pages from the page cache, so the next run
+// reads it from disk.
+void dropFromCache(const string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return;
+    }
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+// Runs one configuration repeats times, keeping the run with the best
+// ingest rate. If cold_path isn't empty it is dropped from the page cache
+// before each run.
+//
+// Returns false (after printing why) if any run fails.
+bool runConfiguration(const vector<string> &args, int repeats, BenchmarkResult &result,
+                        const string &cold_path) {
+    double best_rate = -1;
+
+    for (int r = 0; r < repeats; r++) {
+        if (!cold_path.empty()) {
+            dropFromCache(cold_path);
+        }
+
+        string errors;
+        long peak_rss_kb = 0;
+        RunStats stats;
+
+        if (!runCommand(args, errors, peak_rss_kb) || !parseRunStats(errors, stats)) {
+            cerr << "Failed:";
+            for (size_t i = 0; i < args.size(); i++) {
+                cerr << " " << args[i];
+            }
+            cerr << "\n" << errors;
+            return false;
+        }
+
+        double rate = stats.records / max(stats.ingest_seconds, 1e-9);
+        if (rate > best_rate) {
+            best_rate = rate;
+            result.stats = stats;
+            result.peak_rss_kb = peak_rss_kb;
+        }
+    }
+
+    return true;
+}
+
+void printCsv(const vector<BenchmarkResult> &results) {
+    cout << "engine,input,lights,records,threads,producers,consumers,buffer,channel,"
+        << "ingest_records_per_s,query_us,lock_wait_ms,peak_rss_kb\n";
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult &r = results[i];
+        cout << r.engine << "," << r.input << "," << r.lights << "," << r.stats.records << ","
+            << r.threads << "," << r.producers << "," << r.consumers << "," << r.buffer << ","
+            << r.channel << ","
+            << fixed << setprecision(0) << r.stats.records / r.stats.ingest_seconds << ","
+            << setprecision(1) << r.stats.query_seconds * 1e6 << ","
+            << setprecision(3) << r.stats.lock_wait_seconds * 1e3 << ","
+            << r.peak_rss_kb << "\n";
+    }
+}
+
+void printJson(const vector<BenchmarkResult> &results) {
+    cout << "[\n";
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchmarkResult &r = results[i];
+        cout << "  {\"engine\": \"" << r.engine << "\", \"input\": \"" << r.input << "\""
+            << ", \"lights\": " << r.lights
+            << ", \"records\": " << r.stats.records << ", \"threads\": " << r.threads
+            << ", \"producers\": " << r.producers << ", \"consumers\": " << r.consumers
+            << ", \"buffer\": " << r.buffer << ", \"channel\": \"" << r.channel << "\""
+            << fixed << setprecision(0)
+            << ", \"ingest_records_per_s\": " << r.stats.records / r.stats.ingest_seconds
+            << setprecision(1) << ", \"query_us\": " << r.stats.query_seconds * 1e6
+            << setprecision(3) << ", \"lock_wait_ms\": " << r.stats.lock_wait_seconds * 1e3
+            << ", \"peak_rss_kb\": " << r.peak_rss_kb << "}"
+            << ((i + 1 < results.size()) ? ",\n" : "\n");
+    }
+
+    cout << "]\n";
+}
+
+int main(int argc, char *argv[]) {
+    DriverOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        cerr << "Usage: " << argv[0] << " [--threads=1,2,4] [--ratios=1:1,1:3,3:1]"
+            << " [--buffers=100,1000] [--lights=1000,10000] [--channels=queue,ring]"
+            << " [--input=getline|mmap|partitioned] [--repeats=n] [--format=csv|json]"
+            << " [--work-dir=path] [--pin=spread|cores] [--seq-inputs=getline,mmap,uring]"
+            << " [--cold]\n";
+        return EXIT_FAILURE;
+    }
+
+    // The simulators and generator are built next to the driver.
+    string self = argv[0];
+    size_t slash = self.rfind('/');
+    string bin_dir = (slash == string::npos) ? "." : self.substr(0, slash);
+
+    mkdir(options.work_dir.c_str(), 0755);
+
+    vector<BenchmarkResult> results;
+
+    for (size_t l = 0; l < options.lights.size(); l++) {
+        int lights = options.lights[l];
+        string data_path = options.work_dir + "/data_" + to_string(lights);
+
+        string errors;
+        long peak_rss_kb;
+        if (!runCommand({bin_dir + "/generate_data", "--lights=" + to_string(lights),
+                            "--output=" + data_path}, errors, peak_rss_kb)) {
+            cerr << "Could not generate " << data_path << "\n" << errors;
+            return EXIT_FAILURE;
+        }
+
+        string cold_path = options.cold ? data_path : "";
+
+        // The sequential engine has no threads or channel.
+        for (size_t s = 0; s < options.seq_inputs.size(); s++) {
+            const string &input = options.seq_inputs[s];
+            BenchmarkResult seq = {"seq", input, lights, 1, 1, 1, 100, "none", RunStats(), 0};
+            if (!runConfiguration({bin_dir + "/sequential", "10", "8", "--data=" + data_path,
+                                    "--input=" + input, "--stats"}, options.repeats, seq,
+                                    cold_path)) {
+                return EXIT_FAILURE;
+            }
+            results.push_back(seq);
+        }
+
+        for (size_t t = 0; t < options.threads.size(); t++) {
+            for (size_t r = 0; r < options.ratios.size(); r++) {
+                for (size_t b = 0; b < options.buffers.size(); b++) {
+                    for (size_t c = 0; c < options.channels.size(); c++) {
+                        int threads = options.threads[t];
+                        bool auto_split = (options.ratios[r] == "auto");
+                        int producers = 0, consumers = 0;
+
+                        if (!auto_split) {
+                            int producer_share, consumer_share;
+                            parseRatio(options.ratios[r], producer_share, consumer_share);
+
+                            double producer_fraction = producer_share
+                                        / static_cast<double>(producer_share + consumer_share);
+                            producers = max(1, static_cast<int>(round(threads
+                                                                        * producer_fraction)));
+                            consumers = max(1, threads - producers);
+                        }
+
+                        BenchmarkResult result = {"pthread", options.input, lights, threads,
+                                                    producers, consumers, options.buffers[b],
+                                                    options.channels[c], RunStats(), 0};
+                        string size = to_string(options.buffers[b]);
+
+                        vector<string> args = {bin_dir + "/threaded", "10", "8",
+                                                "--data=" + data_path, "--input=" + options.input,
+                                                "--channel=" + options.channels[c],
+                                                "--threads=" + to_string(threads),
+                                                "--buffer-size=" + size, "--ring-size=" + size,
+                                                "--stats"};
+                        if (auto_split) {
+                            args.push_back("--producers=auto");
+                        }
+                        else {
+                            args.push_back("--producers=" + to_string(producers));
+                            args.push_back("--consumers=" + to_string(consumers));
+                        }
+                        if (!options.pin.empty()) {
+                            args.push_back("--pin=" + options.pin);
+                        }
+
+                        if (!runConfiguration(args, options.repeats, result, cold_path)) {
+                            return EXIT_FAILURE;
+                        }
+
+                        // The split an auto run chose.
+                        if (auto_split) {
+                            result.producers = result.stats.producers;
+                            result.consumers = result.stats.consumers;
+                        }
+                        results.push_back(result);
+                    }
+                }
+            }
+        }
+
+        unlink(data_path.c_str());
+    }
+
+    if (options.format == "json") {
+        printJson(results);
+    }
+    else {
+        printCsv(results);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,140 @@
+// ----------------------------------------------------------------------------
+// File:        BulkWriter.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Buffered output straight to a file descriptor, for printing
+//              results with hundreds of thousands of lines.
+//
+//              Text and integers are formatted into one reused buffer, two
+//              digits at a time from a table, with no std::string
+//              temporaries. The buffer only goes to the kernel, in a single
+//              write(), when it is full or the writer is flushed.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef BULK_WRITER_H
+#define BULK_WRITER_H
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+
+const size_t BULK_WRITER_SIZE = 1 << 16;
+
+// Room always left for one integer (a sign and 20 digits), so appendInt()
+// needn't check.
+const size_t BULK_WRITER_INT_CHARS = 21;
+
+struct BulkWriter {
+    int fd;
+    std::vector<char> buffer;
+    size_t used;
+    bool failed;        // A write failed, later output is dropped.
+};
+
+// Writes all of size bytes, retrying short writes.
+//
+// Returns false if the write fails.
+inline bool writeFully(int fd, const char *bytes, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+inline void initBulkWriter(BulkWriter &writer, int fd, size_t size = BULK_WRITER_SIZE) {
+    writer.fd = fd;
+    writer.buffer.resize(size + BULK_WRITER_INT_CHARS);
+    writer.used = 0;
+    writer.failed = false;
+}
+
+// Writes out what is buffered.
+//
+// Returns false if this or an earlier write failed.
+inline bool flushBulkWriter(BulkWriter &writer) {
+    if (writer.used > 0 && !writer.failed) {
+        writer.failed = !writeFully(writer.fd, writer.buffer.data(), writer.used);
+    }
+    writer.used = 0;
+    return !writer.failed;
+}
+
+// The buffer size not counting the room kept for an integer.
+inline size_t bulkCapacity(const BulkWriter &writer) {
+    return writer.buffer.size() - BULK_WRITER_INT_CHARS;
+}
+
+inline void appendText(BulkWriter &writer, const char *text, size_t length) {
+    while (length > 0) {
+        if (writer.used >= bulkCapacity(writer)) {
+            flushBulkWriter(writer);
+        }
+
+        size_t part = std::min(length, bulkCapacity(writer) - writer.used);
+        memcpy(writer.buffer.data() + writer.used, text, part);
+        writer.used += part;
+        text += part;
+        length -= part;
+    }
+}
+
+// For string literals, so their length is known at compile time.
+template <size_t Size>
+inline void appendText(BulkWriter &writer, const char (&text)[Size]) {
+    appendText(writer, text, Size - 1);
+}
+
+// Writes value in decimal, formatted two digits at a time.
+inline void appendInt(BulkWriter &writer, long long value) {
+    static const char pairs[] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    if (writer.used >= bulkCapacity(writer)) {
+        flushBulkWriter(writer);
+    }
+
+    char *out = writer.buffer.data() + writer.used;
+    unsigned long long magnitude = value;
+    if (value < 0) {
+        *out++ = '-';
+        magnitude = 0ULL - magnitude;
+    }
+
+    // Digits are made from the right into digits, then copied out.
+    char digits[20];
+    char *end = digits + sizeof(digits), *first = end;
+    while (magnitude >= 100) {
+        first -= 2;
+        memcpy(first, pairs + (magnitude % 100) * 2, 2);
+        magnitude /= 100;
+    }
+    if (magnitude >= 10) {
+        first -= 2;
+        memcpy(first, pairs + magnitude * 2, 2);
+    }
+    else {
+        *--first = static_cast<char>('0' + magnitude);
+    }
+
+    memcpy(out, first, end - first);
+    writer.used = (out + (end - first)) - writer.buffer.data();
+}
+
+#endif
@@ -0,0 +1,105 @@
+// ----------------------------------------------------------------------------
+// File:        ConvertData.cpp
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Converts a text data file ("HHMM id cars" lines, as written by
+//              createData.py) to the binary column format described in
+//              TrafficBinaryFormat.h.
+//
+//              Usage: ./convert_data [text file] [binary file]
+//
+//              Lines that can't be parsed, or whose time isn't a time of day,
+//              are left out and reported.
+//
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+#include "TrafficData.h"
+#include "MappedFile.h"
+#include "RecordParser.h"
+#include "TrafficBinaryFormat.h"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+    const char *text_path = (argc > 1) ? argv[1] : "./data";
+    const char *binary_path = (argc > 2) ? argv[2] : "./data.bin";
+
+    MappedFile text_file;
+    if (!mapFile(text_path, text_file)) {
+        cerr << "Could not map " << text_path << "\n";
+        return EXIT_FAILURE;
+    }
+
+    vector<TrafficLightRecord> records;
+    vector<size_t> malformed;
+    parseRecordBuffer(text_file.data, text_file.data + text_file.size, true,
+                        records, &malformed);
+    unmapFile(text_file);
+
+    // Counting sort by hour: count each hour, then place every record after
+    // the ones before it in its hour, which keeps the file order within an
+    // hour.
+    uint64_t hour_counts[HOURS_PER_DAY] = {0};
+    size_t bad_times = 0;
+    for (size_t i = 0; i < records.size(); i++) {
+        int hr = recordHour(records[i]);
+        if (hr == -1) {
+            bad_times++;
+        }
+        else {
+            hour_counts[hr]++;
+        }
+    }
+
+    TrafficBinaryHeader header = makeBinaryHeader(hour_counts);
+    vector<int32_t> time(header.num_records), id(header.num_records),
+                    cars(header.num_records);
+
+    uint64_t next[HOURS_PER_DAY];
+    for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+        next[hr] = header.hour_offsets[hr];
+    }
+
+    for (size_t i = 0; i < records.size(); i++) {
+        int hr = recordHour(records[i]);
+        if (hr == -1) {
+            continue;
+        }
+
+        uint64_t j = next[hr]++;
+        time[j] = records[i].time;
+        id[j] = records[i].id;
+        cars[j] = records[i].cars;
+    }
+
+    ofstream binary_file(binary_path, ios::binary | ios::trunc);
+    vector<char> padded_header(TRAFFIC_BINARY_HEADER_SIZE, 0);
+    memcpy(padded_header.data(), &header, sizeof(header));
+
+    binary_file.write(padded_header.data(), padded_header.size());
+    binary_file.write(reinterpret_cast<const char *>(time.data()), time.size() * sizeof(int32_t));
+    binary_file.write(reinterpret_cast<const char *>(id.data()), id.size() * sizeof(int32_t));
+    binary_file.write(reinterpret_cast<const char *>(cars.data()), cars.size() * sizeof(int32_t));
+
+    if (!binary_file) {
+        cerr << "Could not write " << binary_path << "\n";
+        return EXIT_FAILURE;
+    }
+
+    cout << "Records written:  " << header.num_records << "\n"
+        << "Malformed lines:  " << malformed.size() << "\n"
+        << "Invalid times:    " << bad_times << "\n";
+
+    for (size_t i = 0; i < malformed.size() && i < 5; i++) {
+        cout << "    malformed line at byte offset " << malformed[i] << "\n";
+    }
+
+    return EXIT_SUCCESS;
+}
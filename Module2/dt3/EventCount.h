@@ -0,0 +1,117 @@
+// ----------------------------------------------------------------------------
+// File:        EventCount.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Targeted wakeups for the mutex protected queue channel, in
+//              place of a pthread_cond_broadcast() on every push and pop.
+//
+//              An EventCount is a futex word that is bumped on each notify.
+//              A thread that finds no work reads it while still holding the
+//              channel mutex, then sleeps on it unlocked, so a notify made
+//              after the read (under the mutex) can't be missed. Notifying
+//              wakes only the requested number of sleepers, and makes no
+//              system call at all when nobody is asleep.
+//
+//              Notifications are also batched with watermarks. Producers
+//              only wake consumers once the queue has filled to its high
+//              watermark, and then as many as there are records queued.
+//              Consumers only wake producers once it has drained to its low
+//              watermark, and then as many as there are free slots. So each
+//              woken thread has a batch of work instead of a single record.
+//              A producer never sleeps below the high watermark, nor a
+//              consumer above the low one, so the batching can't leave both
+//              sides asleep.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef EVENT_COUNT_H
+#define EVENT_COUNT_H
+
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <pthread.h>
+
+#include "RingBuffer.h"
+
+struct EventCount {
+    std::atomic<int> sequence;
+    std::atomic<int> waiting;       // Threads asleep (or about to be) on sequence.
+};
+
+inline void eventInit(EventCount &event) {
+    event.sequence = 0;
+    event.waiting = 0;
+}
+
+// Releases mutex, sleeps until the next notify and takes mutex again. Like
+// pthread_cond_wait() it can return without a notify, so the caller loops
+// on its condition.
+//
+// *Note: The mutex must be held by the caller.
+inline void eventWait(EventCount &event, pthread_mutex_t *mutex) {
+    int key = event.sequence.load();
+    event.waiting++;
+    pthread_mutex_unlock(mutex);
+
+    futexWait(&event.sequence, key);
+
+    event.waiting--;
+    pthread_mutex_lock(mutex);
+}
+
+// Wakes up to count sleepers.
+//
+// *Note: The mutex the waiters use must be held by the caller.
+inline void eventNotify(EventCount &event, int count) {
+    if (count > 0 && event.waiting.load() > 0) {
+        event.sequence++;
+        futexWake(&event.sequence, count);
+    }
+}
+
+// The two sides of a queue channel of capacity records.
+struct QueueSignals {
+    EventCount has_task;
+    EventCount has_space;
+    size_t low_watermark;
+    size_t high_watermark;
+};
+
+inline void initQueueSignals(QueueSignals &signals, size_t capacity) {
+    eventInit(signals.has_task);
+    eventInit(signals.has_space);
+    signals.low_watermark = capacity / 4;
+    signals.high_watermark = (capacity * 3 / 4 > 0) ? capacity * 3 / 4 : 1;
+}
+
+// Called by a producer after pushing, leaving size records queued.
+inline void notifyPushed(QueueSignals &signals, size_t size) {
+    if (size >= signals.high_watermark) {
+        eventNotify(signals.has_task, (size < INT_MAX) ? static_cast<int>(size) : INT_MAX);
+    }
+}
+
+// Called by a consumer after popping, leaving size records queued.
+inline void notifyPopped(QueueSignals &signals, size_t size, size_t capacity) {
+    if (size <= signals.low_watermark) {
+        size_t free_slots = capacity - size;
+        eventNotify(signals.has_space,
+                        (free_slots < INT_MAX) ? static_cast<int>(free_slots) : INT_MAX);
+    }
+}
+
+// Called by a producer that is about to exit.
+//
+// A producer woken by notifyPopped() may find the data has run out and exit
+// without using the slot it was woken for. So every producer still asleep
+// is woken to look again, otherwise they could all sleep with the queue
+// empty and the consumers waiting on them.
+inline void notifyProducerExit(QueueSignals &signals) {
+    eventNotify(signals.has_space, INT_MAX);
+}
+
+#endif
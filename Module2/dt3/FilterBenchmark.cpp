@@ -0,0 +1,137 @@
+// ----------------------------------------------------------------------------
+// File:        FilterBenchmark.cpp
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Benchmark of finding one hour's records: the array of
+//              TrafficLightRecords filter in mostCongestion() (divide and
+//              push_back per record) against the branch free scalar and AVX2
+//              filters over RecordColumns' times.
+//
+//              Each is reported as records/s and as GB/s of the bytes it has
+//              to read, next to a plain sum over the times for the memory
+//              bandwidth it is up against. Every filter's matches are checked
+//              against the first.
+//
+//              Usage: ./filter_benchmark [records] [repeats]
+//
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <iomanip>
+#include <string>
+#include <functional>
+
+#include "TrafficData.h"
+#include "RecordColumns.h"
+
+using namespace std::chrono;
+using namespace std;
+
+// Filters the way mostCongestion() on a vector of records does.
+size_t filterRecords(const vector<TrafficLightRecord> &records, int hr_start,
+                        vector<TrafficLightRecord> &subset) {
+    subset.clear();
+
+    for (size_t i = 0; i < records.size(); i++) {
+        int hr_val = records[i].time / 100;
+        if (hr_val >= hr_start && hr_val < hr_start + 1) {
+            subset.push_back(records[i]);
+        }
+    }
+    return subset.size();
+}
+
+void printRow(const string &name, size_t num_records, size_t bytes, double seconds,
+                size_t matches, bool matches_ok) {
+    cout << name << "," << num_records << "," << matches << ","
+        << fixed << setprecision(0) << num_records / seconds << ","
+        << setprecision(2) << bytes / seconds / 1e9 << ","
+        << (matches_ok ? "yes" : "no") << "\n";
+}
+
+int main(int argc, char *argv[]) {
+    size_t num_records = (argc > 1) ? atol(argv[1]) : 50000000;
+    int repeats = (argc > 2) ? atoi(argv[2]) : 5;
+    int hr = 8;
+
+    mt19937 rng(315);
+    uniform_int_distribution<int> random_slot(0, HOURS_PER_DAY * 4 - 1);
+
+    vector<TrafficLightRecord> records(num_records);
+    RecordColumns columns;
+    reserveColumns(columns, num_records);
+
+    for (size_t i = 0; i < num_records; i++) {
+        int slot = random_slot(rng);
+        TrafficLightRecord record = {(slot / 4) * 100 + (slot % 4) * 15,
+                                        static_cast<int>(i), static_cast<int>(i % 100000)};
+        records[i] = record;
+        addToColumns(columns, record);
+    }
+
+    cout << "filter,records,matches,records_per_s,gb_per_s,matches_ok\n";
+
+    // The best of repeats runs of each, so page faults and a cold cache
+    // don't count.
+    double seconds;
+    auto best = [&](const std::function<void()> &run) {
+        double best_seconds = 1e9;
+        for (int r = 0; r < repeats; r++) {
+            auto start = high_resolution_clock::now();
+            run();
+            best_seconds = min(best_seconds, duration_cast<duration<double>>(
+                                                high_resolution_clock::now() - start).count());
+        }
+        return best_seconds;
+    };
+
+    long long sum = 0;
+    seconds = best([&]() {
+        sum = 0;
+        for (size_t i = 0; i < num_records; i++) {
+            sum += columns.times[i];
+        }
+    });
+    printRow("read_times", num_records, num_records * sizeof(int32_t), seconds, 0, sum > 0);
+
+    vector<TrafficLightRecord> subset;
+    size_t expected = 0;
+    seconds = best([&]() { expected = filterRecords(records, hr, subset); });
+    printRow("records_divide", num_records, num_records * sizeof(TrafficLightRecord), seconds,
+                expected, true);
+
+    vector<uint32_t> matches(num_records + 8);
+    size_t count = 0;
+    seconds = best([&]() {
+        count = filterTimesScalar(columns.times.data(), num_records, hr * 100, hr * 100 + 100,
+                                    matches.data());
+    });
+    bool matches_ok = (count == expected);
+    for (size_t i = 0; matches_ok && i < count; i++) {
+        matches_ok = (records[matches[i]].time / 100 == hr);
+    }
+    printRow("columns_scalar", num_records, num_records * sizeof(int32_t), seconds, count,
+                matches_ok);
+
+#ifdef RECORD_COLUMNS_AVX2
+    if (haveAVX2()) {
+        vector<uint32_t> avx2_matches(num_records + 8);
+        seconds = best([&]() {
+            count = filterTimesAVX2(columns.times.data(), num_records, hr * 100, hr * 100 + 100,
+                                        avx2_matches.data());
+        });
+        avx2_matches.resize(count);
+        matches.resize(expected);
+        printRow("columns_avx2", num_records, num_records * sizeof(int32_t), seconds, count,
+                    avx2_matches == matches);
+    }
+#endif
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,488 @@
+// ----------------------------------------------------------------------------
+// File:        GenerateData.cpp
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Generates synthetic traffic data at production scale, in the
+//              text format createData.py writes ("HHMM id cars" lines, every
+//              light for one time then the next time) or straight into the
+//              binary format from TrafficBinaryFormat.h.
+//
+//              The rows are split into blocks of BLOCK_ROWS, which the threads
+//              take in turn. Each block has its own RNG stream seeded from
+//              the seed and the block number, so a given seed gives the same
+//              file for any number of threads.
+//
+//              Text blocks are formatted into each thread's own buffer, then
+//              once a round of blocks is formatted their file offsets are
+//              known and every thread pwrite()s its buffer in one call. Binary
+//              rows go straight to their place in a shared mapping of the
+//              output file.
+//
+//              Usage: ./generate_data [--lights=n] [--interval=minutes]
+//                                     [--days=n] [--distribution=uniform|normal|rush]
+//                                     [--max-cars=n] [--seed=n] [--threads=n]
+//                                     [--format=text|binary] [--output=path]
+//
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "TrafficData.h"
+#include "TrafficBinaryFormat.h"
+
+using namespace std::chrono;
+using namespace std;
+
+const long NUM_CORES = sysconf(_SC_NPROCESSORS_ONLN);
+const uint64_t BLOCK_ROWS = 1 << 18;
+const int MINUTES_PER_DAY = HOURS_PER_DAY * 60;
+
+// The longest text line: "HHMM" and two 10 digit ints, with separators.
+const size_t MAX_LINE_SIZE = 4 + 1 + 10 + 1 + 10 + 1;
+
+struct GeneratorOptions {
+    int lights = 1000;
+    int interval = 15;          // Minutes between each light's records.
+    int days = 1;
+    string distribution = "uniform";
+    int max_cars = 100000;
+    uint64_t seed = 315;
+    int threads = NUM_CORES;
+    string format = "text";     // "text" or "binary".
+    string output = "./data";
+};
+
+// The shape of the file, the same for every thread.
+struct GeneratorLayout {
+    int slots_per_day;
+    uint64_t rows;
+    uint64_t num_blocks;
+
+    // For the binary format: where each hour starts, how many records an
+    // hour has per day, and each slot's hour and place within its hour.
+    uint64_t hour_offsets[HOURS_PER_DAY + 1];
+    uint64_t hour_day_rows[HOURS_PER_DAY];
+    vector<int> slot_hour;
+    vector<int> slot_rank;
+};
+
+// Data for the generator threads.
+struct Generate_ThreadData {
+    const GeneratorOptions *options;
+    const GeneratorLayout *layout;
+    int thread;
+
+    // Text output.
+    int fd;
+    pthread_barrier_t *formatted;
+    pthread_barrier_t *placed;
+    vector<char> buffer;
+    size_t bytes;
+    off_t offset;
+    vector<Generate_ThreadData> *all;
+    off_t *file_size;
+    atomic<bool> *failed;
+
+    // Binary output.
+    int32_t *time;
+    int32_t *id;
+    int32_t *cars;
+};
+
+// Draws the cars for records. One is made per block, so a normal
+// distribution's spare value is kept from one record to the next.
+struct CarSampler {
+    int max_cars;
+    bool uniform;
+    mt19937_64 rng;
+    normal_distribution<double> normal[HOURS_PER_DAY];
+};
+
+void initCarSampler(CarSampler &sampler, const GeneratorOptions &options, uint64_t block) {
+    seed_seq seq = {static_cast<uint32_t>(options.seed),
+                    static_cast<uint32_t>(options.seed >> 32),
+                    static_cast<uint32_t>(block), static_cast<uint32_t>(block >> 32)};
+    sampler.max_cars = options.max_cars;
+    sampler.uniform = (options.distribution == "uniform");
+    sampler.rng.seed(seq);
+
+    // "rush" peaks at 8am and 5:30pm and is quiet overnight, "normal" is
+    // the same all day.
+    for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+        double mean = 0.5;
+        if (options.distribution == "rush") {
+            mean = 0.15 + 0.7 * max(exp(-(hr - 8) * (hr - 8) / 2.0),
+                                    exp(-(hr - 17.5) * (hr - 17.5) / 2.0));
+        }
+        sampler.normal[hr] = normal_distribution<double>(mean * options.max_cars,
+                                                            options.max_cars / 8.0);
+    }
+}
+
+// The cars for one record in hour hr.
+int randomCars(CarSampler &sampler, int hr) {
+    int max_cars = sampler.max_cars;
+
+    if (sampler.uniform) {
+        // The top 32 bits scaled to [0, max_cars], which is faster than
+        // uniform_int_distribution and just as even for ranges this small.
+        return static_cast<int>(((sampler.rng() >> 32) * (max_cars + 1ULL)) >> 32);
+    }
+
+    double cars = sampler.normal[hr](sampler.rng);
+    return static_cast<int>(min<double>(max_cars, max(0.0, round(cars))));
+}
+
+// Where a row (in the text file's order) is: its day, slot and light.
+struct RowPosition {
+    int day;
+    int slot;
+    int light;
+};
+
+RowPosition rowPosition(const GeneratorOptions &options, const GeneratorLayout &layout,
+                            uint64_t row) {
+    uint64_t rows_per_day = static_cast<uint64_t>(layout.slots_per_day) * options.lights;
+    RowPosition position = {static_cast<int>(row / rows_per_day),
+                            static_cast<int>((row % rows_per_day) / options.lights),
+                            static_cast<int>(row % options.lights)};
+    return position;
+}
+
+// Moves position on to the next row, without dividing.
+void nextRow(const GeneratorOptions &options, const GeneratorLayout &layout,
+                RowPosition &position) {
+    if (++position.light == options.lights) {
+        position.light = 0;
+        if (++position.slot == layout.slots_per_day) {
+            position.slot = 0;
+            position.day++;
+        }
+    }
+}
+
+// Writes value's digits at out, at least width of them (zero padded).
+//
+// Returns a pointer past the last digit.
+char *writeInt(char *out, unsigned value, int width = 1) {
+    char digits[10];
+    int n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+
+    while (n < width) {
+        digits[n++] = '0';
+    }
+    while (n > 0) {
+        *out++ = digits[--n];
+    }
+    return out;
+}
+
+// Formats a block of text rows into data->buffer.
+void formatBlock(Generate_ThreadData *data, uint64_t block) {
+    const GeneratorOptions &options = *data->options;
+    const GeneratorLayout &layout = *data->layout;
+    CarSampler sampler;
+    initCarSampler(sampler, options, block);
+
+    uint64_t first = block * BLOCK_ROWS;
+    uint64_t last = min(layout.rows, first + BLOCK_ROWS);
+    char *out = data->buffer.data();
+
+    RowPosition position = rowPosition(options, layout, first);
+
+    for (uint64_t row = first; row < last; row++, nextRow(options, layout, position)) {
+        int minute = position.slot * options.interval;
+        out = writeInt(out, (minute / 60) * 100 + minute % 60, 4);
+        *out++ = ' ';
+        out = writeInt(out, position.light + 1);
+        *out++ = ' ';
+        out = writeInt(out, randomCars(sampler, minute / 60));
+        *out++ = '\n';
+    }
+
+    data->bytes = out - data->buffer.data();
+}
+
+// Worker function for text output. Every thread goes through the same
+// number of rounds so the barriers line up, a thread with no block left in
+// the last round writes nothing.
+void *generateText(void *arg) {
+    Generate_ThreadData *data = static_cast<Generate_ThreadData *>(arg);
+    int num_threads = data->options->threads;
+    uint64_t rounds = (data->layout->num_blocks + num_threads - 1) / num_threads;
+
+    data->buffer.resize(BLOCK_ROWS * MAX_LINE_SIZE);
+
+    for (uint64_t round = 0; round < rounds; round++) {
+        uint64_t block = round * num_threads + data->thread;
+        data->bytes = 0;
+        if (block < data->layout->num_blocks) {
+            formatBlock(data, block);
+        }
+
+        pthread_barrier_wait(data->formatted);
+
+        // Every block of the round is formatted, so the first thread can
+        // lay them out one after another.
+        if (data->thread == 0) {
+            for (int i = 0; i < num_threads; i++) {
+                Generate_ThreadData &other = (*data->all)[i];
+                other.offset = *data->file_size;
+                *data->file_size += other.bytes;
+            }
+        }
+
+        pthread_barrier_wait(data->placed);
+
+        size_t written = 0;
+        while (written < data->bytes) {
+            ssize_t n = pwrite(data->fd, data->buffer.data() + written, data->bytes - written,
+                                data->offset + written);
+            if (n <= 0) {
+                data->failed->store(true);
+                break;
+            }
+            written += n;
+        }
+    }
+
+    pthread_exit(nullptr);
+}
+
+// Worker function for binary output, fills in the blocks data->thread,
+// data->thread + threads, ... of the mapping.
+void *generateBinary(void *arg) {
+    Generate_ThreadData *data = static_cast<Generate_ThreadData *>(arg);
+    const GeneratorOptions &options = *data->options;
+    const GeneratorLayout &layout = *data->layout;
+
+    for (uint64_t block = data->thread; block < layout.num_blocks; block += options.threads) {
+        CarSampler sampler;
+        initCarSampler(sampler, options, block);
+
+        uint64_t first = block * BLOCK_ROWS;
+        uint64_t last = min(layout.rows, first + BLOCK_ROWS);
+
+        RowPosition position = rowPosition(options, layout, first);
+
+        for (uint64_t row = first; row < last; row++, nextRow(options, layout, position)) {
+            int hr = layout.slot_hour[position.slot];
+            int minute = position.slot * options.interval;
+
+            // Within an hour the records are in text file order: by day,
+            // then slot, then light.
+            uint64_t i = layout.hour_offsets[hr] + position.day * layout.hour_day_rows[hr]
+                            + static_cast<uint64_t>(layout.slot_rank[position.slot])
+                                * options.lights
+                            + position.light;
+
+            data->time[i] = (minute / 60) * 100 + minute % 60;
+            data->id[i] = position.light + 1;
+            data->cars[i] = randomCars(sampler, hr);
+        }
+    }
+
+    pthread_exit(nullptr);
+}
+
+// Reads the --name=value options.
+//
+// Returns false (after printing why) if an option isn't recognised.
+bool parseOptions(int argc, char *argv[], GeneratorOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        size_t equals = arg.find('=');
+        string name = arg.substr(0, equals);
+        string value = (equals == string::npos) ? "" : arg.substr(equals + 1);
+        long long number = atoll(value.c_str());
+
+        if (name == "--lights" && number > 0 && number <= INT32_MAX - 1) {
+            options.lights = static_cast<int>(number);
+        }
+        else if (name == "--interval" && number > 0 && number <= MINUTES_PER_DAY) {
+            options.interval = static_cast<int>(number);
+        }
+        else if (name == "--days" && number > 0) {
+            options.days = static_cast<int>(number);
+        }
+        else if (name == "--distribution"
+                    && (value == "uniform" || value == "normal" || value == "rush")) {
+            options.distribution = value;
+        }
+        else if (name == "--max-cars" && number > 0 && number <= INT32_MAX) {
+            options.max_cars = static_cast<int>(number);
+        }
+        else if (name == "--seed" && !value.empty()) {
+            options.seed = strtoull(value.c_str(), nullptr, 10);
+        }
+        else if (name == "--threads" && number > 0) {
+            options.threads = static_cast<int>(number);
+        }
+        else if (name == "--format" && (value == "text" || value == "binary")) {
+            options.format = value;
+        }
+        else if (name == "--output" && !value.empty()) {
+            options.output = value;
+        }
+        else {
+            cerr << "Unknown option: " << arg << "\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void makeLayout(const GeneratorOptions &options, GeneratorLayout &layout) {
+    layout.slots_per_day = (MINUTES_PER_DAY + options.interval - 1) / options.interval;
+    layout.rows = static_cast<uint64_t>(options.days) * layout.slots_per_day * options.lights;
+    layout.num_blocks = (layout.rows + BLOCK_ROWS - 1) / BLOCK_ROWS;
+
+    int slots_in_hour[HOURS_PER_DAY] = {0};
+    layout.slot_hour.resize(layout.slots_per_day);
+    layout.slot_rank.resize(layout.slots_per_day);
+
+    for (int slot = 0; slot < layout.slots_per_day; slot++) {
+        int hr = slot * options.interval / 60;
+        layout.slot_hour[slot] = hr;
+        layout.slot_rank[slot] = slots_in_hour[hr]++;
+    }
+
+    layout.hour_offsets[0] = 0;
+    for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+        layout.hour_day_rows[hr] = static_cast<uint64_t>(slots_in_hour[hr]) * options.lights;
+        layout.hour_offsets[hr + 1] = layout.hour_offsets[hr]
+                                        + options.days * layout.hour_day_rows[hr];
+    }
+}
+
+int main(int argc, char *argv[]) {
+    GeneratorOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        cerr << "Usage: " << argv[0] << " [--lights=n] [--interval=minutes] [--days=n]"
+            << " [--distribution=uniform|normal|rush] [--max-cars=n] [--seed=n]"
+            << " [--threads=n] [--format=text|binary] [--output=path]\n";
+        return EXIT_FAILURE;
+    }
+
+    GeneratorLayout layout;
+    makeLayout(options, layout);
+
+    bool binary = (options.format == "binary");
+    int fd = open(options.output.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        cerr << "Could not open " << options.output << "\n";
+        return EXIT_FAILURE;
+    }
+
+    auto start = high_resolution_clock::now();
+
+    // The binary file's size is known up front, so it is mapped and the
+    // threads write their records straight into it.
+    char *mapping = nullptr;
+    size_t binary_size = 0;
+    if (binary) {
+        uint64_t hour_counts[HOURS_PER_DAY];
+        for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+            hour_counts[hr] = layout.hour_offsets[hr + 1] - layout.hour_offsets[hr];
+        }
+        TrafficBinaryHeader header = makeBinaryHeader(hour_counts);
+        binary_size = header.cars_column + header.num_records * sizeof(int32_t);
+
+        if (ftruncate(fd, binary_size) == -1) {
+            cerr << "Could not size " << options.output << "\n";
+            close(fd);
+            return EXIT_FAILURE;
+        }
+
+        mapping = static_cast<char *>(mmap(nullptr, binary_size, PROT_READ | PROT_WRITE,
+                                            MAP_SHARED, fd, 0));
+        if (mapping == MAP_FAILED) {
+            cerr << "Could not map " << options.output << "\n";
+            close(fd);
+            return EXIT_FAILURE;
+        }
+        memcpy(mapping, &header, sizeof(header));
+    }
+
+    pthread_barrier_t formatted, placed;
+    pthread_barrier_init(&formatted, nullptr, options.threads);
+    pthread_barrier_init(&placed, nullptr, options.threads);
+
+    off_t file_size = 0;
+    atomic<bool> failed(false);
+
+    vector<pthread_t> tid(options.threads);
+    vector<Generate_ThreadData> generate_thread_data(options.threads);
+
+    for (int i = 0; i < options.threads; i++) {
+        Generate_ThreadData &data = generate_thread_data[i];
+        data.options = &options;
+        data.layout = &layout;
+        data.thread = i;
+        data.fd = fd;
+        data.formatted = &formatted;
+        data.placed = &placed;
+        data.all = &generate_thread_data;
+        data.file_size = &file_size;
+        data.failed = &failed;
+
+        if (binary) {
+            const TrafficBinaryHeader *header =
+                reinterpret_cast<const TrafficBinaryHeader *>(mapping);
+            data.time = reinterpret_cast<int32_t *>(mapping + header->time_column);
+            data.id = reinterpret_cast<int32_t *>(mapping + header->id_column);
+            data.cars = reinterpret_cast<int32_t *>(mapping + header->cars_column);
+        }
+
+        pthread_create(&tid[i], nullptr, binary ? generateBinary : generateText, &data);
+    }
+
+    for (int i = 0; i < options.threads; i++) {
+        pthread_join(tid[i], nullptr);
+    }
+
+    if (binary) {
+        munmap(mapping, binary_size);
+        file_size = binary_size;
+    }
+
+    pthread_barrier_destroy(&formatted);
+    pthread_barrier_destroy(&placed);
+    close(fd);
+
+    double seconds = duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+
+    if (failed) {
+        cerr << "Could not write " << options.output << "\n";
+        return EXIT_FAILURE;
+    }
+
+    cout << fixed << setprecision(0)
+        << "Records written:  " << layout.rows << "\n"
+        << "Bytes written:    " << file_size << "\n"
+        << "Records/s:        " << layout.rows / seconds << "\n"
+        << setprecision(1)
+        << "MB/s:             " << file_size / seconds / (1024 * 1024) << "\n";
+
+    return EXIT_SUCCESS;
+}
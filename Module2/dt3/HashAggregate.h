@@ -0,0 +1,267 @@
+// ----------------------------------------------------------------------------
+// File:        HashAggregate.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Total cars per light per hour (a group by (id, hour)), so a
+//              light is ranked once per hour rather than once for each of its
+//              15 minute records.
+//
+//              Each thread sums its share of the records into its own open
+//              addressing hash tables, so there is no locking. The keys are
+//              split into one partition per thread by their hash and each
+//              thread keeps a table per partition. The merge is then done in
+//              parallel too: merge thread p only reads (and combines) every
+//              thread's table for partition p, so each table is read by one
+//              thread and no two threads ever write the same table.
+//
+//              Tables use linear probing on flat arrays of 16 byte slots and
+//              grow at half full, which keeps them fast with millions of
+//              distinct lights where a node based std::unordered_map spends
+//              its time in malloc and cache misses.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef HASH_AGGREGATE_H
+#define HASH_AGGREGATE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <pthread.h>
+#include <utility>
+#include <vector>
+#include <algorithm>
+
+#include "TrafficData.h"
+
+// Marks an empty slot, no (id, hour) key can be this.
+const uint64_t AGGREGATE_EMPTY = ~0ULL;
+
+struct AggregateSlot {
+    uint64_t key;
+    long long cars;
+};
+
+struct AggregateTable {
+    std::vector<AggregateSlot> slots;
+    int bits;       // slots.size() is 2^bits.
+    size_t size;    // Slots in use.
+};
+
+// Data for the aggregation and merge threads.
+//
+// An aggregation thread fills tables[0, num_partitions) from its records, a
+// merge thread combines partition from every thread's locals into tables[0].
+struct Aggregate_ThreadData {
+    const TrafficLightRecord *records;
+    size_t num_records;
+    std::vector<std::vector<AggregateTable> > *locals;
+    int partition;
+    int num_partitions;
+    AggregateTable *tables;
+};
+
+// A light and hour packed into one key.
+inline uint64_t aggregateKey(int id, int hr) {
+    return static_cast<uint64_t>(id) * HOURS_PER_DAY + hr;
+}
+
+inline int keyId(uint64_t key) {
+    return static_cast<int>(key / HOURS_PER_DAY);
+}
+
+inline int keyHour(uint64_t key) {
+    return static_cast<int>(key % HOURS_PER_DAY);
+}
+
+// Fibonacci hashing, multiplying spreads sequential ids over the whole word
+// and the top bits are the best mixed.
+inline uint64_t aggregateHash(uint64_t key) {
+    return key * 0x9E3779B97F4A7C15ULL;
+}
+
+// Sets up table with room for about capacity keys before it has to grow.
+inline void aggregateInit(AggregateTable &table, size_t capacity) {
+    table.bits = 4;
+    while ((1ULL << table.bits) < 2 * capacity) {
+        table.bits++;
+    }
+
+    AggregateSlot empty = {AGGREGATE_EMPTY, 0};
+    table.slots.assign(1ULL << table.bits, empty);
+    table.size = 0;
+}
+
+// Returns the slot for key, which is empty if the key isn't in the table.
+inline AggregateSlot &aggregateFind(AggregateTable &table, uint64_t key) {
+    size_t mask = table.slots.size() - 1;
+    size_t i = aggregateHash(key) >> (64 - table.bits);
+
+    while (table.slots[i].key != key && table.slots[i].key != AGGREGATE_EMPTY) {
+        i = (i + 1) & mask;
+    }
+    return table.slots[i];
+}
+
+inline void aggregateAdd(AggregateTable &table, uint64_t key, long long cars);
+
+// Doubles the number of slots, putting every key back in.
+inline void aggregateGrow(AggregateTable &table) {
+    std::vector<AggregateSlot> old_slots;
+    old_slots.swap(table.slots);
+
+    AggregateSlot empty = {AGGREGATE_EMPTY, 0};
+    table.bits++;
+    table.slots.assign(1ULL << table.bits, empty);
+    table.size = 0;
+
+    for (size_t i = 0; i < old_slots.size(); i++) {
+        if (old_slots[i].key != AGGREGATE_EMPTY) {
+            aggregateAdd(table, old_slots[i].key, old_slots[i].cars);
+        }
+    }
+}
+
+// Adds cars to key's total.
+inline void aggregateAdd(AggregateTable &table, uint64_t key, long long cars) {
+    AggregateSlot &slot = aggregateFind(table, key);
+
+    if (slot.key == AGGREGATE_EMPTY) {
+        // Kept at most half full so probe runs stay short.
+        if (2 * (table.size + 1) > table.slots.size()) {
+            aggregateGrow(table);
+            aggregateAdd(table, key, cars);
+            return;
+        }
+
+        slot.key = key;
+        table.size++;
+    }
+    slot.cars += cars;
+}
+
+// Returns which partition a key belongs to. Uses lower bits of the hash than
+// the table index, so a partition's keys are still spread over its table.
+inline int aggregatePartition(uint64_t key, int num_partitions) {
+    return static_cast<int>((aggregateHash(key) >> 8) % num_partitions);
+}
+
+// Worker function for the aggregation threads, sums one share of the
+// records into the thread's own table for each key's partition.
+inline void *aggregateShare(void *arg) {
+    Aggregate_ThreadData *data = static_cast<Aggregate_ThreadData *>(arg);
+
+    for (size_t i = 0; i < data->num_records; i++) {
+        const TrafficLightRecord &record = data->records[i];
+        int hr = recordHour(record);
+        if (hr != -1) {
+            uint64_t key = aggregateKey(record.id, hr);
+            aggregateAdd(data->tables[aggregatePartition(key, data->num_partitions)],
+                            key, record.cars);
+        }
+    }
+
+    pthread_exit(nullptr);
+}
+
+// Worker function for the merge threads, combines every thread's table for
+// one partition. The first thread's table is taken over as it is, so with
+// one thread there is nothing to merge.
+inline void *mergePartition(void *arg) {
+    Aggregate_ThreadData *data = static_cast<Aggregate_ThreadData *>(arg);
+    std::vector<std::vector<AggregateTable> > &locals = *data->locals;
+    AggregateTable &result = data->tables[0];
+
+    result = std::move(locals[0][data->partition]);
+
+    for (size_t t = 1; t < locals.size(); t++) {
+        const std::vector<AggregateSlot> &slots = locals[t][data->partition].slots;
+
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (slots[i].key != AGGREGATE_EMPTY) {
+                aggregateAdd(result, slots[i].key, slots[i].cars);
+            }
+        }
+
+        // Frees the table now rather than when every partition is done.
+        std::vector<AggregateSlot>().swap(locals[t][data->partition].slots);
+    }
+
+    pthread_exit(nullptr);
+}
+
+// Totals the cars of every (id, hour) in records using num_threads threads.
+// The result is num_threads tables with no key in more than one.
+inline void aggregateRecords(const std::vector<TrafficLightRecord> &records, int num_threads,
+                                std::vector<AggregateTable> &partitions) {
+    num_threads = std::max(1, num_threads);
+
+    std::vector<pthread_t> tid(num_threads);
+    std::vector<Aggregate_ThreadData> aggregate_thread_data(num_threads);
+    std::vector<std::vector<AggregateTable> > locals(num_threads,
+                                                        std::vector<AggregateTable>(num_threads));
+
+    size_t share = (records.size() + num_threads - 1) / num_threads;
+
+    for (int i = 0; i < num_threads; i++) {
+        size_t begin = std::min(records.size(), i * share);
+        size_t end = std::min(records.size(), begin + share);
+
+        // Records per (id, hour) are usually few (4 with 15 minute data), so
+        // start at a quarter of the share and let the tables grow if there
+        // are more keys.
+        for (int p = 0; p < num_threads; p++) {
+            aggregateInit(locals[i][p], (end - begin) / 4 / num_threads);
+        }
+
+        aggregate_thread_data[i].records = records.data() + begin;
+        aggregate_thread_data[i].num_records = end - begin;
+        aggregate_thread_data[i].num_partitions = num_threads;
+        aggregate_thread_data[i].tables = locals[i].data();
+
+        pthread_create(&tid[i], nullptr, aggregateShare, &aggregate_thread_data[i]);
+    }
+
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(tid[i], nullptr);
+    }
+
+    partitions.assign(num_threads, AggregateTable());
+
+    for (int i = 0; i < num_threads; i++) {
+        aggregate_thread_data[i].locals = &locals;
+        aggregate_thread_data[i].partition = i;
+        aggregate_thread_data[i].tables = &partitions[i];
+
+        pthread_create(&tid[i], nullptr, mergePartition, &aggregate_thread_data[i]);
+    }
+
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(tid[i], nullptr);
+    }
+}
+
+// Returns the N lights that passed the most cars in hour hr, in increasing
+// order of cars. Fewer than N are returned if fewer lights have records in
+// that hour.
+inline std::vector<LightTotal> mostCongestedAggregate(
+        const std::vector<AggregateTable> &partitions, int hr, int N) {
+    std::vector<LightTotal> totals;
+
+    for (size_t p = 0; p < partitions.size(); p++) {
+        const std::vector<AggregateSlot> &slots = partitions[p].slots;
+
+        for (size_t i = 0; i < slots.size(); i++) {
+            if (slots[i].key != AGGREGATE_EMPTY && keyHour(slots[i].key) == hr) {
+                LightTotal total = {keyId(slots[i].key), slots[i].cars};
+                totals.push_back(total);
+            }
+        }
+    }
+
+    return topNLightTotals(totals, N);
+}
+
+#endif
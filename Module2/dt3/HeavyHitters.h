@@ -0,0 +1,372 @@
+// ----------------------------------------------------------------------------
+// File:        HeavyHitters.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Approximate busiest lights per hour in fixed memory, for feeds
+//              with too many distinct lights to total exactly (see
+//              HashAggregate.h for the exact totals).
+//
+//              Each hour has a Space-Saving sketch of capacity counters. A
+//              light with a counter adds its cars to it. A light without one
+//              takes over the smallest counter, starting from that count and
+//              recording it as the error. So an estimate is never below a
+//              light's real total and never more than total cars / capacity
+//              above it, where the capacity is 1 / error.
+//
+//              The counters are a min-heap on cars, with an open addressing
+//              table from light id to heap position, so both finding a light
+//              and finding the smallest counter are cheap.
+//
+//              Each consumer fills its own sketches with no locking, and they
+//              are merged at the end. A light missing from one sketch counts
+//              as that sketch's smallest counter (if it is full), so the merge
+//              keeps the same error bound.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef HEAVY_HITTERS_H
+#define HEAVY_HITTERS_H
+
+#include <cmath>
+#include <cstddef>
+#include <pthread.h>
+#include <vector>
+#include <algorithm>
+
+#include "TrafficData.h"
+
+const double DEFAULT_SKETCH_ERROR = 0.001;
+
+struct HeavyHitter {
+    int id;
+    long long cars;     // Estimated total, never below the real one.
+    long long error;    // How far above the real total cars can be.
+    int slot;           // Position in the sketch's table.
+};
+
+// One hour's counters.
+struct SpaceSaving {
+    size_t capacity;
+    std::vector<HeavyHitter> heap;  // Min-heap on cars.
+    std::vector<int> table;         // Heap positions by id, -1 for empty.
+    int bits;                       // table.size() is 2^bits.
+    long long total;                // Cars added.
+};
+
+// One thread's sketch for each hour.
+struct HeavyHitterSketches {
+    double error;
+    SpaceSaving hours[HOURS_PER_DAY];
+};
+
+// Data for the threads of sketchRecords(), each sketching one share of the
+// records.
+struct Sketch_ThreadData {
+    const TrafficLightRecord *records;
+    size_t num_records;
+    HeavyHitterSketches *sketches;
+};
+
+// Returns the counters needed to keep estimates within error x total cars.
+inline size_t sketchCapacity(double error) {
+    return std::max<size_t>(static_cast<size_t>(std::ceil(1 / error)), 1);
+}
+
+inline size_t sketchHome(const SpaceSaving &sketch, int id) {
+    return (static_cast<unsigned>(id) * 0x9E3779B9u) >> (32 - sketch.bits);
+}
+
+inline void initSpaceSaving(SpaceSaving &sketch, size_t capacity) {
+    sketch.capacity = capacity;
+    sketch.total = 0;
+    sketch.heap.clear();
+    sketch.heap.reserve(capacity);
+
+    // At most half full, so probes stay short.
+    sketch.bits = 1;
+    while ((static_cast<size_t>(1) << sketch.bits) < 2 * capacity) {
+        sketch.bits++;
+    }
+    sketch.table.assign(static_cast<size_t>(1) << sketch.bits, -1);
+}
+
+// Returns id's table slot, which is empty if id has no counter.
+inline size_t sketchFind(const SpaceSaving &sketch, int id) {
+    size_t mask = sketch.table.size() - 1;
+    size_t slot = sketchHome(sketch, id);
+    while (sketch.table[slot] != -1 && sketch.heap[sketch.table[slot]].id != id) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Empties a table slot, moving later entries of the same probe run back so
+// none is left after a gap.
+inline void sketchErase(SpaceSaving &sketch, size_t slot) {
+    size_t mask = sketch.table.size() - 1;
+    size_t next = slot;
+
+    while (true) {
+        next = (next + 1) & mask;
+        if (sketch.table[next] == -1) {
+            break;
+        }
+
+        // An entry can fill the gap if its home isn't between the gap and it.
+        size_t home = sketchHome(sketch, sketch.heap[sketch.table[next]].id);
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            sketch.table[slot] = sketch.table[next];
+            sketch.heap[sketch.table[slot]].slot = slot;
+            slot = next;
+        }
+    }
+    sketch.table[slot] = -1;
+}
+
+inline void sketchSwap(SpaceSaving &sketch, size_t a, size_t b) {
+    std::swap(sketch.heap[a], sketch.heap[b]);
+    sketch.table[sketch.heap[a].slot] = a;
+    sketch.table[sketch.heap[b].slot] = b;
+}
+
+// Moves the counter at i down after its cars went up. Counts only ever go
+// up, so that is the only way a counter moves.
+inline void sketchSiftDown(SpaceSaving &sketch, size_t i) {
+    size_t size = sketch.heap.size();
+    while (true) {
+        size_t smallest = i, left = 2 * i + 1, right = left + 1;
+        if (left < size && sketch.heap[left].cars < sketch.heap[smallest].cars) {
+            smallest = left;
+        }
+        if (right < size && sketch.heap[right].cars < sketch.heap[smallest].cars) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+        sketchSwap(sketch, i, smallest);
+        i = smallest;
+    }
+}
+
+// Adds cars to id's estimate, taking over the smallest counter if id has
+// none and the sketch is full.
+inline void spaceSavingAdd(SpaceSaving &sketch, int id, long long cars) {
+    sketch.total += cars;
+    size_t slot = sketchFind(sketch, id);
+
+    if (sketch.table[slot] != -1) {
+        size_t i = sketch.table[slot];
+        sketch.heap[i].cars += cars;
+        sketchSiftDown(sketch, i);
+    }
+    else if (sketch.heap.size() < sketch.capacity) {
+        // A new counter goes at the end of the heap and moves up past any
+        // larger parents.
+        HeavyHitter counter = {id, cars, 0, static_cast<int>(slot)};
+        size_t i = sketch.heap.size();
+        sketch.heap.push_back(counter);
+        sketch.table[slot] = i;
+
+        while (i > 0 && sketch.heap[(i - 1) / 2].cars > sketch.heap[i].cars) {
+            sketchSwap(sketch, i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+    }
+    else if (sketch.capacity > 0) {
+        HeavyHitter &smallest = sketch.heap[0];
+        sketchErase(sketch, smallest.slot);
+
+        // Erasing can move entries, so id's slot is found again.
+        slot = sketchFind(sketch, id);
+        smallest.id = id;
+        smallest.error = smallest.cars;
+        smallest.cars += cars;
+        smallest.slot = slot;
+        sketch.table[slot] = 0;
+        sketchSiftDown(sketch, 0);
+    }
+}
+
+inline bool compHeavyHitterMinHeap(const HeavyHitter &h_a, const HeavyHitter &h_b) {
+    return (h_a.cars > h_b.cars);
+}
+
+// Makes sketch's heap and table from counters, keeping the capacity
+// largest.
+inline void rebuildSketch(SpaceSaving &sketch, std::vector<HeavyHitter> &counters) {
+    if (counters.size() > sketch.capacity) {
+        nth_element(counters.begin(), counters.begin() + sketch.capacity, counters.end(),
+                    compHeavyHitterMinHeap);
+        counters.resize(sketch.capacity);
+    }
+    make_heap(counters.begin(), counters.end(), compHeavyHitterMinHeap);
+
+    sketch.heap.swap(counters);
+    std::fill(sketch.table.begin(), sketch.table.end(), -1);
+    for (size_t i = 0; i < sketch.heap.size(); i++) {
+        size_t slot = sketchFind(sketch, sketch.heap[i].id);
+        sketch.heap[i].slot = slot;
+        sketch.table[slot] = i;
+    }
+}
+
+inline bool compHeavyHitterId(const HeavyHitter &h_a, const HeavyHitter &h_b) {
+    return (h_a.id < h_b.id);
+}
+
+// The smallest count a light missing from a sketch could have.
+inline long long sketchFloor(const SpaceSaving &sketch) {
+    return (sketch.heap.size() < sketch.capacity || sketch.heap.empty()) ? 0
+                : sketch.heap[0].cars;
+}
+
+// Adds other's counters into sketch, which must have the same capacity.
+inline void mergeSpaceSaving(SpaceSaving &sketch, const SpaceSaving &other) {
+    long long floors[2] = {sketchFloor(sketch), sketchFloor(other)};
+
+    // Each light appears at most once in each sketch, so after sorting by
+    // id a light is one or two neighbouring counters (in source order).
+    std::vector<HeavyHitter> counters(sketch.heap);
+    for (size_t i = 0; i < counters.size(); i++) {
+        counters[i].slot = 0;
+    }
+    for (size_t i = 0; i < other.heap.size(); i++) {
+        counters.push_back(other.heap[i]);
+        counters.back().slot = 1;
+    }
+    stable_sort(counters.begin(), counters.end(), compHeavyHitterId);
+
+    std::vector<HeavyHitter> merged;
+    merged.reserve(counters.size());
+    for (size_t i = 0; i < counters.size(); i++) {
+        HeavyHitter counter = counters[i];
+
+        if (i + 1 < counters.size() && counters[i + 1].id == counter.id) {
+            counter.cars += counters[i + 1].cars;
+            counter.error += counters[i + 1].error;
+            i++;
+        }
+        else {
+            // slot says which sketch it came from, the other could have had
+            // up to its floor.
+            long long floor = floors[1 - counter.slot];
+            counter.cars += floor;
+            counter.error += floor;
+        }
+        merged.push_back(counter);
+    }
+
+    sketch.total += other.total;
+    rebuildSketch(sketch, merged);
+}
+
+inline void initHeavyHitters(HeavyHitterSketches &sketches, double error) {
+    sketches.error = error;
+    for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+        initSpaceSaving(sketches.hours[hr], sketchCapacity(error));
+    }
+}
+
+// Adds a record's cars to its light's estimate for its hour.
+//
+// Returns false (and ignores the record) if its time isn't a time of day or
+// its cars are negative, which Space-Saving can't count.
+inline bool addToHeavyHitters(HeavyHitterSketches &sketches, const TrafficLightRecord &record) {
+    int hr = recordHour(record);
+    if (hr == -1 || record.cars < 0) {
+        return false;
+    }
+
+    spaceSavingAdd(sketches.hours[hr], record.id, record.cars);
+    return true;
+}
+
+// Merges num_sketches threads' sketches into result, which is initialised
+// with the same error.
+inline void mergeHeavyHitters(const HeavyHitterSketches *sketches, int num_sketches,
+                                HeavyHitterSketches &result) {
+    initHeavyHitters(result, (num_sketches > 0) ? sketches[0].error : DEFAULT_SKETCH_ERROR);
+
+    for (int i = 0; i < num_sketches; i++) {
+        for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+            mergeSpaceSaving(result.hours[hr], sketches[i].hours[hr]);
+        }
+    }
+}
+
+// Worker function for the threads of sketchRecords().
+inline void *sketchShare(void *arg) {
+    Sketch_ThreadData *data = static_cast<Sketch_ThreadData *>(arg);
+
+    for (size_t i = 0; i < data->num_records; i++) {
+        addToHeavyHitters(*data->sketches, data->records[i]);
+    }
+
+    pthread_exit(nullptr);
+}
+
+// Sketches records with num_threads threads, each with its own sketches,
+// then merges them into result.
+inline void sketchRecords(const std::vector<TrafficLightRecord> &records, int num_threads,
+                            double error, HeavyHitterSketches &result) {
+    num_threads = std::max(1, num_threads);
+
+    std::vector<pthread_t> tid(num_threads);
+    std::vector<Sketch_ThreadData> sketch_thread_data(num_threads);
+    std::vector<HeavyHitterSketches> locals(num_threads);
+
+    size_t share = (records.size() + num_threads - 1) / num_threads;
+
+    for (int i = 0; i < num_threads; i++) {
+        size_t begin = std::min(records.size(), i * share);
+        size_t end = std::min(records.size(), begin + share);
+
+        initHeavyHitters(locals[i], error);
+        sketch_thread_data[i].records = records.data() + begin;
+        sketch_thread_data[i].num_records = end - begin;
+        sketch_thread_data[i].sketches = &locals[i];
+
+        pthread_create(&tid[i], nullptr, sketchShare, &sketch_thread_data[i]);
+    }
+
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(tid[i], nullptr);
+    }
+
+    mergeHeavyHitters(locals.data(), num_threads, result);
+}
+
+// Bytes a thread's sketches take.
+inline size_t sketchBytes(const HeavyHitterSketches &sketches) {
+    size_t bytes = 0;
+    for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+        bytes += sketches.hours[hr].capacity * sizeof(HeavyHitter)
+                    + sketches.hours[hr].table.size() * sizeof(int);
+    }
+    return bytes;
+}
+
+// Returns the N lights with the highest estimated cars in hour hr, in
+// increasing order of cars. Fewer than N are returned if fewer lights have
+// counters, and N above the capacity can't all be trusted.
+inline std::vector<LightTotal> mostCongestedSketch(const HeavyHitterSketches &sketches, int hr,
+                                                    int N) {
+    std::vector<LightTotal> totals;
+    if (hr < 0 || hr >= HOURS_PER_DAY) {
+        return totals;
+    }
+
+    const std::vector<HeavyHitter> &heap = sketches.hours[hr].heap;
+    for (size_t i = 0; i < heap.size(); i++) {
+        LightTotal total = {heap[i].id, heap[i].cars};
+        totals.push_back(total);
+    }
+
+    return topNLightTotals(totals, N);
+}
+
+#endif
@@ -0,0 +1,206 @@
+// ----------------------------------------------------------------------------
+// File:        HourIndex.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              An index of records partitioned by hour, so mostCongestion()
+//              only reads the hour it is asked about instead of scanning and
+//              dividing the time of every record.
+//
+//              Records are put in per-hour buckets as they are ingested (one
+//              set of buckets per consumer thread, so no locking is needed),
+//              then buildHourIndex() lays the buckets out as 24 contiguous
+//              partitions of one vector.
+//
+//              The buckets and index work on any record type with a
+//              recordHour() and topNRecords(), so TrafficLightRecord or
+//              PackedRecord.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef HOUR_INDEX_H
+#define HOUR_INDEX_H
+
+#include <cstddef>
+#include <pthread.h>
+#include <vector>
+#include <algorithm>
+
+#include "TrafficData.h"
+#include "ParallelSelect.h"
+#include "TrafficBinaryFormat.h"
+
+// One thread's records, split up by hour while they are ingested.
+template <typename Record>
+struct HourBucketsOf {
+    std::vector<Record> hours[HOURS_PER_DAY];
+};
+
+// Every record grouped by hour: hour hr is [offsets[hr], offsets[hr + 1]) of
+// records.
+template <typename Record>
+struct HourIndexOf {
+    std::vector<Record> records;
+    size_t offsets[HOURS_PER_DAY + 1];
+};
+
+typedef HourBucketsOf<TrafficLightRecord> HourBuckets;
+typedef HourIndexOf<TrafficLightRecord> HourIndex;
+
+// Data for the threads that copy buckets into the index.
+template <typename Record>
+struct Index_ThreadData {
+    const HourBucketsOf<Record> *buckets;
+    Record *destinations[HOURS_PER_DAY];
+};
+
+// Reserves room for about expected_records records over the whole day.
+template <typename Record>
+void reserveBuckets(HourBucketsOf<Record> &buckets, size_t expected_records) {
+    for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+        buckets.hours[hr].reserve(expected_records / HOURS_PER_DAY);
+    }
+}
+
+// Puts a record in its hour's bucket.
+//
+// Returns false (and drops the record) if its time isn't a time of day.
+template <typename Record>
+bool addToBuckets(HourBucketsOf<Record> &buckets, const Record &record) {
+    int hr = recordHour(record);
+    if (hr == -1) {
+        return false;
+    }
+
+    buckets.hours[hr].push_back(record);
+    return true;
+}
+
+// Worker function for the index threads, copies one set of buckets into
+// their places in each hour's partition.
+template <typename Record>
+void *copyBuckets(void *arg) {
+    Index_ThreadData<Record> *data = static_cast<Index_ThreadData<Record> *>(arg);
+
+    for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+        const std::vector<Record> &bucket = data->buckets->hours[hr];
+        std::copy(bucket.begin(), bucket.end(), data->destinations[hr]);
+    }
+
+    pthread_exit(nullptr);
+}
+
+// Builds index from num_buckets sets of buckets, with one thread per set
+// copying its records into place (a single set is copied by the caller, so
+// the sequential simulator doesn't start any threads).
+//
+// Within an hour the records of buckets[0] come first, then buckets[1] and
+// so on, the same order as concatenating the threads' records.
+template <typename Record>
+void buildHourIndex(const HourBucketsOf<Record> *buckets, int num_buckets,
+                        HourIndexOf<Record> &index) {
+    index.offsets[0] = 0;
+    for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+        size_t hour_size = 0;
+        for (int i = 0; i < num_buckets; i++) {
+            hour_size += buckets[i].hours[hr].size();
+        }
+        index.offsets[hr + 1] = index.offsets[hr] + hour_size;
+    }
+
+    index.records.resize(index.offsets[HOURS_PER_DAY]);
+
+    if (num_buckets == 1) {
+        for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+            std::copy(buckets[0].hours[hr].begin(), buckets[0].hours[hr].end(),
+                        index.records.begin() + index.offsets[hr]);
+        }
+        return;
+    }
+
+    std::vector<pthread_t> tid(num_buckets);
+    std::vector<Index_ThreadData<Record> > index_thread_data(num_buckets);
+
+    size_t next[HOURS_PER_DAY];
+    std::copy(index.offsets, index.offsets + HOURS_PER_DAY, next);
+
+    for (int i = 0; i < num_buckets; i++) {
+        index_thread_data[i].buckets = &buckets[i];
+        for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+            index_thread_data[i].destinations[hr] = index.records.data() + next[hr];
+            next[hr] += buckets[i].hours[hr].size();
+        }
+
+        pthread_create(&tid[i], nullptr, copyBuckets<Record>, &index_thread_data[i]);
+    }
+
+    for (int i = 0; i < num_buckets; i++) {
+        pthread_join(tid[i], nullptr);
+    }
+}
+
+// Builds index from a binary data file, which is already grouped by hour so
+// its hour offsets are used as they are.
+inline void buildHourIndex(const BinaryTrafficData &data, HourIndex &index) {
+    std::copy(data.header->hour_offsets, data.header->hour_offsets + HOURS_PER_DAY + 1,
+                index.offsets);
+
+    index.records.resize(data.header->num_records);
+    for (size_t i = 0; i < index.records.size(); i++) {
+        TrafficLightRecord record = {data.time[i], data.id[i], data.cars[i]};
+        index.records[i] = record;
+    }
+}
+
+// Returns the number of records in hour hr (0 for an hour outside the day).
+template <typename Record>
+size_t hourSize(const HourIndexOf<Record> &index, int hr) {
+    if (hr < 0 || hr >= HOURS_PER_DAY) {
+        return 0;
+    }
+    return index.offsets[hr + 1] - index.offsets[hr];
+}
+
+// Sorts each hour's partition by cars, so the top N of an hour are the last
+// N records of its partition and a query needs no selection at all. Worth
+// it when one index answers many queries.
+inline void rankHourIndex(HourIndex &index) {
+    for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+        sort(index.records.begin() + index.offsets[hr],
+                index.records.begin() + index.offsets[hr + 1], compRecord);
+    }
+}
+
+// mostCongestion() for an indexed dataset, only hour hr's partition is read.
+//
+// @param N how many of the most congested lights you want data on.
+// @param hr the hour of the day that you care about.
+template <typename Record>
+std::vector<Record> mostCongestion(const HourIndexOf<Record> &index, int hr, int N) {
+    std::vector<Record> subset;
+
+    if (hourSize(index, hr) > 0) {
+        subset.assign(index.records.begin() + index.offsets[hr],
+                        index.records.begin() + index.offsets[hr + 1]);
+    }
+
+    return topNRecords(subset, N);
+}
+
+// mostCongestion() with the selection spread over num_threads threads (see
+// ParallelSelect.h), for hours too large for one core. The partition is read
+// in place instead of copied.
+template <typename Record>
+std::vector<Record> mostCongestion(const HourIndexOf<Record> &index, int hr, int N,
+                                    int num_threads) {
+    if (hourSize(index, hr) == 0) {
+        return std::vector<Record>();
+    }
+
+    return parallelTopNRecords(index.records.data() + index.offsets[hr], hourSize(index, hr),
+                                N, num_threads);
+}
+
+#endif
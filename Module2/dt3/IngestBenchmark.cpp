@@ -0,0 +1,98 @@
+// ----------------------------------------------------------------------------
+// File:        IngestBenchmark.cpp
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Compares how many records per second can be read from a data
+//              file with the getline + istringstream path used by the
+//              simulators against parsing straight out of an mmap of the
+//              file.
+//
+//              Usage: ./ingest_benchmark [data file] [repeats]
+//
+//              *Note: The first run of each path warms the page cache, so
+//              the best of the repeats is reported.
+//
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iomanip>
+
+#include "TrafficData.h"
+#include "MappedFile.h"
+
+using namespace std::chrono;
+using namespace std;
+
+// Reads every record with getline and stringToRecord().
+size_t ingestGetline(const char *path, vector<TrafficLightRecord> &records) {
+    ifstream data_file(path);
+    string line;
+
+    while (getline(data_file, line)) {
+        records.push_back(stringToRecord(line));
+    }
+
+    return records.size();
+}
+
+// Reads every record straight out of a mapping of the file.
+size_t ingestMapped(const char *path, vector<TrafficLightRecord> &records) {
+    MappedFile mapped;
+    if (!mapFile(path, mapped)) {
+        return 0;
+    }
+
+    const char *cursor = mapped.data;
+    TrafficLightRecord record;
+    while (nextMappedRecord(cursor, mapped.data + mapped.size, record)) {
+        records.push_back(record);
+    }
+
+    unmapFile(mapped);
+    return records.size();
+}
+
+// Runs an ingest function repeats times and returns the best records/sec.
+double bestRate(size_t (*ingest)(const char *, vector<TrafficLightRecord> &),
+                    const char *path, int repeats, size_t &num_records) {
+    double best = 0;
+
+    for (int i = 0; i < repeats; i++) {
+        vector<TrafficLightRecord> records;
+
+        auto start = high_resolution_clock::now();
+        num_records = ingest(path, records);
+        auto stop = high_resolution_clock::now();
+
+        double seconds = duration_cast<duration<double>>(stop - start).count();
+        best = max(best, num_records / seconds);
+    }
+
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = (argc > 1) ? argv[1] : "./data";
+    int repeats = (argc > 2) ? atoi(argv[2]) : 3;
+
+    size_t getline_records, mapped_records;
+    double getline_rate = bestRate(ingestGetline, path, repeats, getline_records);
+    double mapped_rate = bestRate(ingestMapped, path, repeats, mapped_records);
+
+    cout << fixed << setprecision(0)
+        << "getline records:     " << getline_records << "\n"
+        << "getline records/s:   " << getline_rate << "\n"
+        << "mmap records:        " << mapped_records << "\n"
+        << "mmap records/s:      " << mapped_rate << "\n"
+        << setprecision(2)
+        << "mmap speed increase: " << mapped_rate / getline_rate << "\n";
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,162 @@
+// ----------------------------------------------------------------------------
+// File:        MappedFile.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Memory-mapped (mmap) access to the data file so records can be
+//              parsed straight out of the file's bytes. Unlike the getline
+//              path there is no std::string or std::istringstream created for
+//              each line, the kernel pages the file in and we walk a pointer
+//              along it.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "TrafficData.h"
+#include "RecordParser.h"
+
+struct MappedFile {
+    const char *data;
+    size_t size;
+    int fd;
+};
+
+// Returns the size of the file at path in bytes, or 0 if it can't be read.
+inline size_t fileSize(const char *path) {
+    struct stat info;
+    return (stat(path, &info) == 0) ? info.st_size : 0;
+}
+
+// Maps the whole of the file at path read-only.
+//
+// Returns false if the file can't be opened or mapped. An empty file is
+// valid and gives a MappedFile with a size of 0 and no mapping.
+inline bool mapFile(const char *path, MappedFile &file) {
+    file.data = nullptr;
+    file.size = 0;
+    file.fd = open(path, O_RDONLY);
+
+    if (file.fd == -1) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(file.fd, &info) == -1) {
+        close(file.fd);
+        file.fd = -1;
+        return false;
+    }
+
+    file.size = info.st_size;
+    if (file.size == 0) {
+        return true;
+    }
+
+    void *mapping = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+    if (mapping == MAP_FAILED) {
+        close(file.fd);
+        file.fd = -1;
+        file.size = 0;
+        return false;
+    }
+
+    // The file is read front to back, so the kernel can read ahead
+    // aggressively and drop pages behind us.
+    madvise(mapping, file.size, MADV_SEQUENTIAL);
+
+    file.data = static_cast<const char *>(mapping);
+    return true;
+}
+
+inline void unmapFile(MappedFile &file) {
+    if (file.data != nullptr) {
+        munmap(const_cast<char *>(file.data), file.size);
+    }
+    if (file.fd != -1) {
+        close(file.fd);
+    }
+
+    file.data = nullptr;
+    file.size = 0;
+    file.fd = -1;
+}
+
+// A part of a mapped file, [begin, end).
+struct ByteRange {
+    const char *begin;
+    const char *end;
+};
+
+// Splits the file into num_parts ranges of about the same size, with every
+// boundary moved forward to just after a '\n' so no line is cut in two.
+//
+// Some ranges can be empty if the file has fewer lines than num_parts.
+inline std::vector<ByteRange> splitLines(const MappedFile &file, int num_parts) {
+    std::vector<ByteRange> ranges(num_parts);
+    const char *end = file.data + file.size;
+    const char *begin = file.data;
+
+    for (int i = 0; i < num_parts; i++) {
+        const char *split = file.data + file.size * (i + 1) / num_parts;
+
+        if (split < begin) {
+            split = begin;
+        }
+        if (i == num_parts - 1) {
+            split = end;
+        }
+        else if (split > begin && split < end && *(split - 1) != '\n') {
+            const char *newline = static_cast<const char *>(memchr(split, '\n', end - split));
+            split = (newline == nullptr) ? end : newline + 1;
+        }
+
+        ranges[i].begin = begin;
+        ranges[i].end = split;
+        begin = split;
+    }
+
+    return ranges;
+}
+
+// Parses the next "HHMM id cars" line at cursor into record and moves cursor
+// past the line.
+//
+// Lines that aren't three integers (like the notes at the top of the
+// submitted data file) are skipped.
+//
+// Returns false once the end of the mapping is reached.
+inline bool nextMappedRecord(const char *&cursor, const char *end,
+                                TrafficLightRecord &record) {
+    while (cursor < end) {
+        const char *line = cursor;
+        const char *line_end = static_cast<const char *>(memchr(line, '\n', end - line));
+
+        if (line_end == nullptr) {
+            line_end = end;
+            cursor = end;
+        }
+        else {
+            cursor = line_end + 1;
+        }
+
+        if (parseRecordLine(line, line_end, record, end)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#endif
@@ -0,0 +1,99 @@
+// ----------------------------------------------------------------------------
+// File:        OutputBenchmark.cpp
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Benchmark of printing a large top N ranking: visualRecord()
+//              strings streamed through cout, the way the simulators used to
+//              print, against BulkWriter in each of its formats.
+//
+//              stdout is pointed at /dev/null so only the formatting and
+//              the system calls are timed, the results are printed on
+//              stderr.
+//
+//              Usage: ./output_benchmark [records] [repeats]
+//
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <iomanip>
+#include <string>
+#include <functional>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "TrafficData.h"
+#include "BulkWriter.h"
+
+using namespace std::chrono;
+using namespace std;
+
+int main(int argc, char *argv[]) {
+    size_t num_records = (argc > 1) ? atol(argv[1]) : 500000;
+    int repeats = (argc > 2) ? atoi(argv[2]) : 5;
+
+    mt19937 rng(315);
+    uniform_int_distribution<int> random_cars(0, 100000);
+
+    vector<TrafficLightRecord> records(num_records);
+    for (size_t i = 0; i < num_records; i++) {
+        TrafficLightRecord record = {800 + static_cast<int>(i % 4) * 15,
+                                        static_cast<int>(i + 1), random_cars(rng)};
+        records[i] = record;
+    }
+    int N = num_records;
+
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd == -1) {
+        cerr << "Could not open /dev/null\n";
+        return EXIT_FAILURE;
+    }
+    int saved_stdout = dup(STDOUT_FILENO);
+    dup2(null_fd, STDOUT_FILENO);
+
+    // The best of repeats runs of each.
+    auto best = [&](const std::function<void()> &run) {
+        double best_seconds = 1e9;
+        for (int r = 0; r < repeats; r++) {
+            auto start = high_resolution_clock::now();
+            run();
+            best_seconds = min(best_seconds, duration_cast<duration<double>>(
+                                                high_resolution_clock::now() - start).count());
+        }
+        return best_seconds;
+    };
+
+    cerr << "output,records,records_per_s,speed_increase\n";
+
+    double baseline_seconds = best([&]() {
+        for (int i = records.size() - 1; i >= 0; i--) {
+            cout << "(" + to_string(N - i) + ")\n" << visualRecord(records[i]) << "\n\n";
+        }
+        cout << flush;
+    });
+    cerr << "cout_visual_record," << num_records << "," << fixed << setprecision(0)
+        << num_records / baseline_seconds << ",1.00\n";
+
+    const char *formats[] = {"human", "csv", "jsonl"};
+    for (int f = 0; f < 3; f++) {
+        double seconds = best([&]() {
+            BulkWriter writer;
+            initBulkWriter(writer, STDOUT_FILENO);
+            writeMostCongested(writer, records, N, formats[f]);
+            flushBulkWriter(writer);
+        });
+
+        cerr << "bulk_" << formats[f] << "," << num_records << "," << setprecision(0)
+            << num_records / seconds << "," << setprecision(2)
+            << baseline_seconds / seconds << "\n";
+    }
+
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(null_fd);
+    return EXIT_SUCCESS;
+}
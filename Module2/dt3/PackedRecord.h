@@ -0,0 +1,116 @@
+// ----------------------------------------------------------------------------
+// File:        PackedRecord.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              An 8 byte traffic light record, a third smaller than the 12
+//              bytes of TrafficLightRecord, for moving and storing large
+//              datasets with less memory and bandwidth.
+//
+//              The fields are bit-packed into one 64 bit integer:
+//
+//                  bits 63 - 42    cars            22 bits (up to 4,194,303)
+//                  bits 41 - 11    id              31 bits (any int >= 0)
+//                  bits 10 - 0     minute of day   11 bits (0 to 1439)
+//
+//              Storing the minute of the day instead of HHMM is what makes
+//              the time fit in 11 bits. With cars in the top bits, comparing
+//              the packed integers orders by cars first, so ranking needs no
+//              unpacking (ties are broken by id then time).
+//
+// ----------------------------------------------------------------------------
+
+#ifndef PACKED_RECORD_H
+#define PACKED_RECORD_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "TrafficData.h"
+
+struct PackedRecord {
+    uint64_t bits;
+};
+
+const int PACKED_MINUTE_BITS = 11;
+const int PACKED_ID_BITS = 31;
+const int PACKED_CARS_BITS = 22;
+
+const int PACKED_ID_SHIFT = PACKED_MINUTE_BITS;
+const int PACKED_CARS_SHIFT = PACKED_MINUTE_BITS + PACKED_ID_BITS;
+
+const uint64_t PACKED_MINUTE_MASK = (1ULL << PACKED_MINUTE_BITS) - 1;
+const uint64_t PACKED_ID_MASK = (1ULL << PACKED_ID_BITS) - 1;
+const uint64_t PACKED_MAX_CARS = (1ULL << PACKED_CARS_BITS) - 1;
+
+// Packs record.
+//
+// Returns false if it doesn't fit: its time isn't a time of day, or its id
+// or cars are negative or its cars are over PACKED_MAX_CARS.
+inline bool packRecord(const TrafficLightRecord &record, PackedRecord &packed) {
+    int hr = record.time / 100, min = record.time % 100;
+
+    if (record.time < 0 || hr >= HOURS_PER_DAY || min >= 60 || record.id < 0
+            || record.cars < 0 || static_cast<uint64_t>(record.cars) > PACKED_MAX_CARS) {
+        return false;
+    }
+
+    packed.bits = (static_cast<uint64_t>(record.cars) << PACKED_CARS_SHIFT)
+                    | (static_cast<uint64_t>(record.id) << PACKED_ID_SHIFT)
+                    | static_cast<uint64_t>(hr * 60 + min);
+    return true;
+}
+
+inline int packedMinute(const PackedRecord &packed) {
+    return static_cast<int>(packed.bits & PACKED_MINUTE_MASK);
+}
+
+inline int packedId(const PackedRecord &packed) {
+    return static_cast<int>((packed.bits >> PACKED_ID_SHIFT) & PACKED_ID_MASK);
+}
+
+inline int packedCars(const PackedRecord &packed) {
+    return static_cast<int>(packed.bits >> PACKED_CARS_SHIFT);
+}
+
+inline TrafficLightRecord unpackRecord(const PackedRecord &packed) {
+    int minute = packedMinute(packed);
+    TrafficLightRecord record = {(minute / 60) * 100 + minute % 60, packedId(packed),
+                                    packedCars(packed)};
+    return record;
+}
+
+// recordHour() for packed records, -1 if the minute isn't in the day.
+inline int recordHour(const PackedRecord &packed) {
+    int hr = packedMinute(packed) / 60;
+    return (hr < HOURS_PER_DAY) ? hr : -1;
+}
+
+// Comparer for use in sorting packed records, by cars first.
+inline bool compPackedRecord(const PackedRecord r_a, const PackedRecord r_b) {
+    return (r_a.bits < r_b.bits);
+}
+
+// topNRecords() for packed records. subset is reordered.
+inline std::vector<PackedRecord> topNRecords(std::vector<PackedRecord> &subset, int N) {
+    N = std::min(N, static_cast<int>(subset.size()));
+
+    nth_element(subset.begin(), subset.end() - N, subset.end(), compPackedRecord);
+    std::vector<PackedRecord> N_most_congested_lights(subset.end() - N, subset.end());
+    sort(N_most_congested_lights.begin(), N_most_congested_lights.end(), compPackedRecord);
+
+    return N_most_congested_lights;
+}
+
+inline std::vector<TrafficLightRecord> unpackRecords(const std::vector<PackedRecord> &packed) {
+    std::vector<TrafficLightRecord> records(packed.size());
+    for (size_t i = 0; i < packed.size(); i++) {
+        records[i] = unpackRecord(packed[i]);
+    }
+    return records;
+}
+
+#endif
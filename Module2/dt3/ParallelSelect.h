@@ -0,0 +1,155 @@
+// ----------------------------------------------------------------------------
+// File:        ParallelSelect.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Top N selection over one very large hour (tens of millions of
+//              records with 10M lights) using every core instead of one.
+//
+//              Each thread scans its share of the records keeping its own top
+//              N in a min-heap, so after the first few thousand records almost
+//              every record is rejected with one compare and nothing is
+//              copied (for large N it copies its share and does an
+//              nth_element instead). The threads' candidates (at most N each)
+//              are then ranked together the same way topNRecords() ranks a
+//              subset.
+//
+//              The ranking orders (compRecord(), compPackedRecord()) are total
+//              orders, so the result is exactly the ranking topNRecords()
+//              gives, ties and all, for any number of threads.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef PARALLEL_SELECT_H
+#define PARALLEL_SELECT_H
+
+#include <cstddef>
+#include <pthread.h>
+#include <vector>
+#include <algorithm>
+
+#include "TrafficData.h"
+#include "PackedRecord.h"
+
+// Below this many records per thread, starting another thread costs more
+// than it saves.
+const size_t PARALLEL_SELECT_MIN_SHARE = 1 << 16;
+
+// A thread only keeps a heap when its share is at least this many times N.
+const size_t PARALLEL_SELECT_HEAP_RATIO = 64;
+
+// Ranks records of either type the way mostCongestion() does.
+struct RankLess {
+    bool operator()(const TrafficLightRecord &r_a, const TrafficLightRecord &r_b) const {
+        return compRecord(r_a, r_b);
+    }
+
+    bool operator()(const PackedRecord &r_a, const PackedRecord &r_b) const {
+        return compPackedRecord(r_a, r_b);
+    }
+};
+
+// The reverse of RankLess, so the std heap functions keep the least
+// congested candidate at the root.
+struct RankGreater {
+    template <typename Record>
+    bool operator()(const Record &r_a, const Record &r_b) const {
+        return RankLess()(r_b, r_a);
+    }
+};
+
+// Data for the selection threads.
+template <typename Record>
+struct TopN_ThreadData {
+    const Record *records;
+    size_t num_records;
+    int N;
+    std::vector<Record> candidates;
+};
+
+// Worker function for the selection threads, keeps the top N of one share of
+// the records in candidates.
+template <typename Record>
+void *selectShare(void *arg) {
+    TopN_ThreadData<Record> *data = static_cast<TopN_ThreadData<Record> *>(arg);
+    std::vector<Record> &heap = data->candidates;
+    RankGreater greater;
+
+    // With a large N most records would go through the heap, so the share is
+    // copied and selected from instead.
+    if (static_cast<size_t>(data->N) * PARALLEL_SELECT_HEAP_RATIO > data->num_records) {
+        size_t keep = std::min(static_cast<size_t>(data->N), data->num_records);
+
+        heap.assign(data->records, data->records + data->num_records);
+        nth_element(heap.begin(), heap.end() - keep, heap.end(), RankLess());
+        heap.erase(heap.begin(), heap.end() - keep);
+
+        pthread_exit(nullptr);
+    }
+
+    heap.clear();
+    heap.reserve(data->N);
+
+    for (size_t i = 0; i < data->num_records; i++) {
+        const Record &record = data->records[i];
+
+        if (heap.size() < static_cast<size_t>(data->N)) {
+            heap.push_back(record);
+            push_heap(heap.begin(), heap.end(), greater);
+        }
+        else if (greater(record, heap.front())) {
+            pop_heap(heap.begin(), heap.end(), greater);
+            heap.back() = record;
+            push_heap(heap.begin(), heap.end(), greater);
+        }
+    }
+
+    pthread_exit(nullptr);
+}
+
+// Returns the N most congested of records[0, num_records) in increasing
+// order, the same as topNRecords() on a copy of them, using up to
+// num_threads threads. Fewer than N are returned if there are fewer records.
+template <typename Record>
+std::vector<Record> parallelTopNRecords(const Record *records, size_t num_records, int N,
+                                            int num_threads) {
+    N = static_cast<int>(std::min(static_cast<size_t>(std::max(N, 0)), num_records));
+    num_threads = static_cast<int>(std::max<size_t>(1, std::min<size_t>(num_threads,
+                                        num_records / PARALLEL_SELECT_MIN_SHARE)));
+
+    std::vector<Record> candidates;
+
+    if (N > 0) {
+        std::vector<pthread_t> tid(num_threads);
+        std::vector<TopN_ThreadData<Record> > topN_thread_data(num_threads);
+
+        size_t share = (num_records + num_threads - 1) / num_threads;
+
+        for (int i = 0; i < num_threads; i++) {
+            size_t begin = std::min(num_records, i * share);
+
+            topN_thread_data[i].records = records + begin;
+            topN_thread_data[i].num_records = std::min(num_records, begin + share) - begin;
+            topN_thread_data[i].N = N;
+
+            pthread_create(&tid[i], nullptr, selectShare<Record>, &topN_thread_data[i]);
+        }
+
+        for (int i = 0; i < num_threads; i++) {
+            pthread_join(tid[i], nullptr);
+            candidates.insert(candidates.end(), topN_thread_data[i].candidates.begin(),
+                                topN_thread_data[i].candidates.end());
+        }
+    }
+
+    // The merge is a topNRecords() over at most num_threads * N candidates.
+    nth_element(candidates.begin(), candidates.end() - N, candidates.end(), RankLess());
+    std::vector<Record> N_most_congested_lights(candidates.end() - N, candidates.end());
+    sort(N_most_congested_lights.begin(), N_most_congested_lights.end(), RankLess());
+
+    return N_most_congested_lights;
+}
+
+#endif
@@ -0,0 +1,117 @@
+// ----------------------------------------------------------------------------
+// File:        ParserBenchmark.cpp
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Microbenchmark of parsing "HHMM id cars" lines with the
+//              istringstream based stringToRecord() against the SWAR parser
+//              in RecordParser.h.
+//
+//              The whole data file is read into memory first so that only
+//              parsing is timed, not the disk or page cache.
+//
+//              Usage: ./parser_benchmark [data file] [repeats]
+//
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iomanip>
+#include <cstring>
+
+#include "TrafficData.h"
+#include "RecordParser.h"
+
+using namespace std::chrono;
+using namespace std;
+
+// Splits the buffer into lines and parses each one with stringToRecord(),
+// which is what the getline path in the simulators does.
+void parseStringStream(const string &buffer, vector<TrafficLightRecord> &records) {
+    const char *line = buffer.data();
+    const char *end = buffer.data() + buffer.size();
+
+    while (line < end) {
+        const char *line_end = static_cast<const char *>(memchr(line, '\n', end - line));
+        if (line_end == nullptr) {
+            line_end = end;
+        }
+
+        records.push_back(stringToRecord(string(line, line_end)));
+        line = line_end + 1;
+    }
+}
+
+void parseSwar(const string &buffer, vector<TrafficLightRecord> &records) {
+    parseRecordBuffer(buffer.data(), buffer.data() + buffer.size(), true, records);
+}
+
+// Runs a parser repeats times and returns the best time per record in ns.
+double bestTime(void (*parse)(const string &, vector<TrafficLightRecord> &),
+                    const string &buffer, int repeats,
+                    vector<TrafficLightRecord> &records) {
+    double best = 0;
+
+    for (int i = 0; i < repeats; i++) {
+        records.clear();
+        records.shrink_to_fit();
+
+        auto start = high_resolution_clock::now();
+        parse(buffer, records);
+        auto stop = high_resolution_clock::now();
+
+        double ns = duration_cast<nanoseconds>(stop - start).count()
+                        / static_cast<double>(max<size_t>(records.size(), 1));
+        best = (i == 0) ? ns : min(best, ns);
+    }
+
+    return best;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = (argc > 1) ? argv[1] : "./data";
+    int repeats = (argc > 2) ? atoi(argv[2]) : 5;
+
+    ifstream data_file(path, ios::binary);
+    stringstream contents;
+    contents << data_file.rdbuf();
+    string buffer = contents.str();
+
+    vector<TrafficLightRecord> stream_records, swar_records;
+    double stream_ns = bestTime(parseStringStream, buffer, repeats, stream_records);
+    double swar_ns = bestTime(parseSwar, buffer, repeats, swar_records);
+
+    // The SWAR parser skips malformed lines, so the results are only
+    // compared for files where every line is a record.
+    vector<size_t> malformed;
+    vector<TrafficLightRecord> checked;
+    parseRecordBuffer(buffer.data(), buffer.data() + buffer.size(), true,
+                        checked, &malformed);
+
+    bool same = stream_records.size() == swar_records.size();
+    for (size_t i = 0; same && i < swar_records.size(); i++) {
+        same = stream_records[i].time == swar_records[i].time
+                && stream_records[i].id == swar_records[i].id
+                && stream_records[i].cars == swar_records[i].cars;
+    }
+
+    cout << fixed << setprecision(2)
+        << "records:               " << swar_records.size() << "\n"
+        << "malformed lines:       " << malformed.size() << "\n";
+    for (size_t i = 0; i < malformed.size() && i < 5; i++) {
+        cout << "    at byte offset " << malformed[i] << "\n";
+    }
+    cout << "istringstream ns/rec:  " << stream_ns << "\n"
+        << "SWAR ns/rec:           " << swar_ns << "\n"
+        << "SWAR speed increase:   " << stream_ns / swar_ns << "\n"
+        << "results match:         "
+        << (malformed.empty() ? (same ? "yes" : "NO") : "n/a (malformed lines)") << "\n";
+
+    return EXIT_SUCCESS;
+}
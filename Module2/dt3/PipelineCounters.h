@@ -0,0 +1,128 @@
+// ----------------------------------------------------------------------------
+// File:        PipelineCounters.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Per-thread contention counters for the producer/consumer
+//              pipeline, to tell whether a run is limited by parsing, by the
+//              mutex or by waiting on the condition variables.
+//
+//              Each thread only writes its own counters, so counting is a
+//              few plain adds. The clock is only read where a thread is about
+//              to block anyway: around a contended lock or a condition wait.
+//
+//              Building with -DNO_PIPELINE_COUNTERS compiles every counter,
+//              and the --counters option, out. PIPELINE_COUNT(statement) is
+//              how the simulator counts, so the statement disappears with
+//              them.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef PIPELINE_COUNTERS_H
+#define PIPELINE_COUNTERS_H
+
+#ifdef NO_PIPELINE_COUNTERS
+
+#define PIPELINE_COUNT(...)
+
+#else
+
+#define PIPELINE_COUNT(...) __VA_ARGS__
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+// Queue occupancy is sampled at every push and pop into this many equal
+// slices of the buffer's capacity.
+const int OCCUPANCY_BUCKETS = 8;
+
+struct ThreadCounters {
+    const char *role;               // "producer" or "consumer".
+    long long records;              // Pushed by a producer, stored by a consumer.
+    long long lock_ns;              // Blocked acquiring the mutex.
+    long long wait_space_ns;        // Blocked on buff_has_space (producers).
+    long long wait_task_ns;         // Blocked on buff_has_task (consumers).
+    long long waits;                // Condition waits returned from.
+    long long empty_wakeups;        // Of those, ones that found no work.
+    long long occupancy[OCCUPANCY_BUCKETS];
+};
+
+inline void initCounters(ThreadCounters &counters, const char *role) {
+    memset(&counters, 0, sizeof(counters));
+    counters.role = role;
+}
+
+inline void countOccupancy(ThreadCounters &counters, size_t size, size_t capacity) {
+    size_t bucket = size * OCCUPANCY_BUCKETS / (capacity + 1);
+    counters.occupancy[(bucket < OCCUPANCY_BUCKETS) ? bucket : OCCUPANCY_BUCKETS - 1]++;
+}
+
+// Adds the time since start to ns.
+inline void countWait(long long &ns, std::chrono::high_resolution_clock::time_point start) {
+    ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// One row per thread, times in milliseconds, occupancy as the share of
+// samples in each slice of the buffer from empty to full.
+inline void printCounterTable(std::ostream &out, const std::vector<ThreadCounters> &threads) {
+    out << std::left << std::setw(7) << "thread" << std::setw(10) << "role"
+        << std::right << std::setw(11) << "records" << std::setw(10) << "lock_ms"
+        << std::setw(10) << "space_ms" << std::setw(10) << "task_ms"
+        << std::setw(10) << "waits" << std::setw(10) << "empty"
+        << "  occupancy % (empty .. full)\n";
+
+    for (size_t t = 0; t < threads.size(); t++) {
+        const ThreadCounters &c = threads[t];
+
+        long long samples = 0;
+        for (int b = 0; b < OCCUPANCY_BUCKETS; b++) {
+            samples += c.occupancy[b];
+        }
+
+        out << std::left << std::setw(7) << t << std::setw(10) << c.role
+            << std::right << std::setw(11) << c.records << std::fixed << std::setprecision(2)
+            << std::setw(10) << c.lock_ns / 1e6 << std::setw(10) << c.wait_space_ns / 1e6
+            << std::setw(10) << c.wait_task_ns / 1e6
+            << std::setw(10) << c.waits << std::setw(10) << c.empty_wakeups << " ";
+
+        out << std::setprecision(0);
+        for (int b = 0; b < OCCUPANCY_BUCKETS; b++) {
+            out << std::setw(4) << ((samples > 0) ? 100.0 * c.occupancy[b] / samples : 0);
+        }
+        out << "\n";
+    }
+}
+
+// The same counters as one line of JSON, times in nanoseconds and the
+// occupancy histogram as raw sample counts.
+inline void printCountersJson(std::ostream &out, const std::vector<ThreadCounters> &threads) {
+    out << "{\"threads\": [";
+
+    for (size_t t = 0; t < threads.size(); t++) {
+        const ThreadCounters &c = threads[t];
+        out << ((t > 0) ? ", " : "")
+            << "{\"thread\": " << t << ", \"role\": \"" << c.role << "\""
+            << ", \"records\": " << c.records << ", \"lock_ns\": " << c.lock_ns
+            << ", \"wait_space_ns\": " << c.wait_space_ns
+            << ", \"wait_task_ns\": " << c.wait_task_ns << ", \"waits\": " << c.waits
+            << ", \"empty_wakeups\": " << c.empty_wakeups << ", \"occupancy\": [";
+
+        for (int b = 0; b < OCCUPANCY_BUCKETS; b++) {
+            out << ((b > 0) ? ", " : "") << c.occupancy[b];
+        }
+        out << "]}";
+    }
+
+    out << "]}\n";
+}
+
+#endif
+
+#endif
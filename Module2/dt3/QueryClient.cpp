@@ -0,0 +1,160 @@
+// ----------------------------------------------------------------------------
+// File:        QueryClient.cpp
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Load generator for the simulator's query server:
+//
+//                  ./threaded --serve=/tmp/traffic.sock --input=partitioned
+//                  ./query_client /tmp/traffic.sock
+//
+//              Each client thread keeps one connection open and sends random
+//              (N, hr) queries back to back, timing every round trip. The
+//              p50 and p99 latency over all of them and the overall queries
+//              per second are printed as CSV.
+//
+//              Usage: ./query_client socket [clients] [queries per client]
+//                                           [max N]
+//
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "TrafficData.h"
+#include "QueryProtocol.h"
+
+using namespace std::chrono;
+using namespace std;
+
+const long NUM_CORES = sysconf(_SC_NPROCESSORS_ONLN);
+
+// Data for client threads.
+struct Client_ThreadData {
+    string socket_path;
+    int num_queries;
+    int max_N;
+    unsigned seed;
+    vector<long> latencies_ns;
+    long failures;
+};
+
+// Worker function for client threads.
+void *runClient(void *arg) {
+    Client_ThreadData *data = static_cast<Client_ThreadData *>(arg);
+    data->failures = 0;
+
+    int fd = connectQueryServer(data->socket_path);
+    if (fd == -1) {
+        data->failures = data->num_queries;
+        pthread_exit(nullptr);
+    }
+
+    mt19937 rng(data->seed);
+    uniform_int_distribution<int> random_N(1, data->max_N);
+    uniform_int_distribution<int> random_hr(0, HOURS_PER_DAY - 1);
+
+    data->latencies_ns.reserve(data->num_queries);
+    vector<QueryRecord> records;
+
+    for (int i = 0; i < data->num_queries; i++) {
+        QueryRequest request = {random_N(rng), random_hr(rng)};
+        QueryResponseHeader header;
+
+        auto start = high_resolution_clock::now();
+
+        bool answered = writeFull(fd, &request, sizeof(request))
+                        && readFull(fd, &header, sizeof(header));
+        if (answered && header.count > 0) {
+            records.resize(header.count);
+            answered = readFull(fd, records.data(), header.count * sizeof(QueryRecord));
+        }
+
+        auto stop = high_resolution_clock::now();
+
+        if (!answered) {
+            data->failures += data->num_queries - i;
+            break;
+        }
+        if (header.status != QUERY_OK) {
+            data->failures++;
+        }
+
+        data->latencies_ns.push_back(duration_cast<nanoseconds>(stop - start).count());
+    }
+
+    close(fd);
+    pthread_exit(nullptr);
+}
+
+// Returns the p-th percentile of sorted latencies, in microseconds.
+double percentileMicros(const vector<long> &sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t i = static_cast<size_t>(p / 100 * (sorted.size() - 1) + 0.5);
+    return sorted[i] / 1000.0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " socket [clients] [queries per client] [max N]\n";
+        return EXIT_FAILURE;
+    }
+
+    string socket_path = argv[1];
+    int num_clients = (argc > 2) ? atoi(argv[2]) : NUM_CORES;
+    int num_queries = (argc > 3) ? atoi(argv[3]) : 10000;
+    int max_N = (argc > 4) ? atoi(argv[4]) : 10;
+
+    if (num_clients < 1 || num_queries < 1 || max_N < 1) {
+        cerr << "clients, queries and max N must be positive\n";
+        return EXIT_FAILURE;
+    }
+
+    vector<pthread_t> tid(num_clients);
+    vector<Client_ThreadData> client_thread_data(num_clients);
+
+    auto start = high_resolution_clock::now();
+
+    for (int i = 0; i < num_clients; i++) {
+        client_thread_data[i].socket_path = socket_path;
+        client_thread_data[i].num_queries = num_queries;
+        client_thread_data[i].max_N = max_N;
+        client_thread_data[i].seed = i + 1;
+
+        pthread_create(&tid[i], nullptr, runClient, &client_thread_data[i]);
+    }
+
+    for (int i = 0; i < num_clients; i++) {
+        pthread_join(tid[i], nullptr);
+    }
+
+    double seconds = duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+
+    vector<long> latencies;
+    long failures = 0;
+    for (int i = 0; i < num_clients; i++) {
+        latencies.insert(latencies.end(), client_thread_data[i].latencies_ns.begin(),
+                            client_thread_data[i].latencies_ns.end());
+        failures += client_thread_data[i].failures;
+    }
+    sort(latencies.begin(), latencies.end());
+
+    cout << "clients,queries,failures,queries_per_s,p50_us,p99_us,max_us\n";
+    cout << num_clients << "," << latencies.size() << "," << failures << ","
+        << fixed << setprecision(0) << latencies.size() / seconds << ","
+        << setprecision(1) << percentileMicros(latencies, 50) << ","
+        << percentileMicros(latencies, 99) << ","
+        << percentileMicros(latencies, 100) << "\n";
+
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
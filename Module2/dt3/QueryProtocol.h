@@ -0,0 +1,128 @@
+// ----------------------------------------------------------------------------
+// File:        QueryProtocol.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              The binary protocol spoken over the query server's Unix domain
+//              socket (see QueryServer.h), shared by the server and
+//              query_client.
+//
+//              A client keeps its connection open and sends any number of
+//              requests, one at a time:
+//
+//                  request     QueryRequest            8 bytes
+//                  response    QueryResponseHeader     8 bytes
+//                              QueryRecord x count     12 bytes each
+//
+//              The records are most congested first. All integers are native
+//              byte order, both ends are on the same machine.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef QUERY_PROTOCOL_H
+#define QUERY_PROTOCOL_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+const int32_t QUERY_OK = 0;
+const int32_t QUERY_BAD_REQUEST = 1;
+
+struct QueryRequest {
+    int32_t N;
+    int32_t hr;
+};
+
+struct QueryResponseHeader {
+    int32_t status;     // QUERY_OK or QUERY_BAD_REQUEST.
+    int32_t count;      // Records that follow, fewer than N if the hour has.
+};
+
+struct QueryRecord {
+    int32_t time;
+    int32_t id;
+    int32_t cars;
+};
+
+// Reads exactly size bytes, retrying short reads.
+//
+// Returns false on EOF or an error.
+inline bool readFull(int fd, void *buffer, size_t size) {
+    char *bytes = static_cast<char *>(buffer);
+    while (size > 0) {
+        ssize_t n = read(fd, bytes, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Writes exactly size bytes, retrying short writes. MSG_NOSIGNAL stops a
+// closed connection from killing the process with SIGPIPE.
+//
+// Returns false on an error.
+inline bool writeFull(int fd, const void *buffer, size_t size) {
+    const char *bytes = static_cast<const char *>(buffer);
+    while (size > 0) {
+        ssize_t n = send(fd, bytes, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Fills in the address of the socket at path.
+//
+// Returns false if path is too long for a Unix socket address.
+inline bool querySocketAddress(const std::string &path, sockaddr_un &address) {
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+// Connects to the query server listening at path.
+//
+// Returns the socket, or -1 if it can't connect.
+inline int connectQueryServer(const std::string &path) {
+    sockaddr_un address;
+    if (!querySocketAddress(path, address)) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        return -1;
+    }
+
+    if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+#endif
@@ -0,0 +1,266 @@
+// ----------------------------------------------------------------------------
+// File:        QueryServer.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              A resident query server, so the data is ingested once and then
+//              any number of top N queries are answered from memory over a
+//              Unix domain socket (protocol in QueryProtocol.h).
+//
+//              The index is ranked (see rankHourIndex()) before serving, so
+//              answering a query is just copying the end of its hour's
+//              partition into the response. Each connection gets its own
+//              thread and the index is only ever read, so no locking is
+//              needed.
+//
+//              The server runs until it gets SIGINT or SIGTERM, then closes
+//              any open connections and removes its socket file. The signals
+//              are blocked in connection threads so the listening thread
+//              handles them, and the handler writes to a pipe the listener
+//              polls alongside the socket, so a signal can't be missed
+//              between checking the stop flag and waiting.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+#include <algorithm>
+
+#include "TrafficData.h"
+#include "HourIndex.h"
+#include "QueryProtocol.h"
+
+// Shared by the server and its connection threads. The open connections are
+// kept so they can be shut down (and their threads waited for) before the
+// index goes away.
+struct QueryServerState {
+    const HourIndex *index;
+    pthread_mutex_t mutex;
+    pthread_cond_t all_closed;
+    std::vector<int> open_fds;
+    std::atomic<long> queries_answered;
+};
+
+// Data for connection threads.
+struct Connection_ThreadData {
+    int fd;
+    QueryServerState *state;
+};
+
+// Set by the signal handler to stop accepting connections.
+static volatile sig_atomic_t query_server_stopping = 0;
+
+// The write end of the pipe that wakes the listener's poll().
+static int query_server_wake_fd = -1;
+
+inline void stopQueryServer(int) {
+    int saved_errno = errno;
+    query_server_stopping = 1;
+    if (query_server_wake_fd != -1) {
+        ssize_t ignored = write(query_server_wake_fd, "", 1);
+        (void) ignored;
+    }
+    errno = saved_errno;
+}
+
+// Fills response with the answer to request from a ranked index.
+inline void answerRequest(const HourIndex &index, const QueryRequest &request,
+                            std::vector<char> &response) {
+    QueryResponseHeader header = {QUERY_BAD_REQUEST, 0};
+
+    if (request.N > 0 && request.hr >= 0 && request.hr < HOURS_PER_DAY) {
+        header.status = QUERY_OK;
+        header.count = static_cast<int32_t>(
+            std::min(static_cast<size_t>(request.N), hourSize(index, request.hr)));
+    }
+
+    response.resize(sizeof(header) + header.count * sizeof(QueryRecord));
+    memcpy(response.data(), &header, sizeof(header));
+
+    // Most congested first, from the end of the hour's partition.
+    QueryRecord *records = reinterpret_cast<QueryRecord *>(response.data() + sizeof(header));
+    for (int32_t i = 0; i < header.count; i++) {
+        const TrafficLightRecord &record = index.records[index.offsets[request.hr + 1] - 1 - i];
+        QueryRecord query_record = {record.time, record.id, record.cars};
+        records[i] = query_record;
+    }
+}
+
+// Worker function for connection threads, answers requests until the client
+// disconnects.
+inline void *serveConnection(void *arg) {
+    Connection_ThreadData *data = static_cast<Connection_ThreadData *>(arg);
+    QueryServerState *state = data->state;
+
+    QueryRequest request;
+    std::vector<char> response;
+
+    while (readFull(data->fd, &request, sizeof(request))) {
+        answerRequest(*state->index, request, response);
+
+        // The whole response goes in one write.
+        if (!writeFull(data->fd, response.data(), response.size())) {
+            break;
+        }
+        state->queries_answered.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    pthread_mutex_lock(&state->mutex);
+    state->open_fds.erase(find(state->open_fds.begin(), state->open_fds.end(), data->fd));
+    close(data->fd);
+    if (state->open_fds.empty()) {
+        pthread_cond_signal(&state->all_closed);
+    }
+    pthread_mutex_unlock(&state->mutex);
+
+    delete data;
+    pthread_exit(nullptr);
+}
+
+// Serves queries on a ranked index from a socket at socket_path until the
+// process is sent SIGINT or SIGTERM.
+//
+// Returns false if the socket can't be set up.
+inline bool runQueryServer(const std::string &socket_path, const HourIndex &index) {
+    sockaddr_un address;
+    if (!querySocketAddress(socket_path, address)) {
+        std::cerr << "Socket path is too long: " << socket_path << "\n";
+        return false;
+    }
+
+    // A socket left by an earlier server is replaced, but nothing else is.
+    struct stat existing;
+    if (lstat(socket_path.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            std::cerr << socket_path << " already exists and is not a socket\n";
+            return false;
+        }
+        unlink(socket_path.c_str());
+    }
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (listen_fd == -1
+            || bind(listen_fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == -1
+            || listen(listen_fd, SOMAXCONN) == -1) {
+        std::cerr << "Could not listen on " << socket_path << ": " << strerror(errno) << "\n";
+        if (listen_fd != -1) {
+            close(listen_fd);
+        }
+        return false;
+    }
+
+    // The handler's writes must never block, and the pipe is read to know
+    // it has run.
+    int wake_fds[2];
+    if (pipe(wake_fds) == -1) {
+        std::cerr << "Could not create the wakeup pipe: " << strerror(errno) << "\n";
+        close(listen_fd);
+        unlink(socket_path.c_str());
+        return false;
+    }
+    fcntl(wake_fds[1], F_SETFL, O_NONBLOCK);
+    query_server_wake_fd = wake_fds[1];
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopQueryServer;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    // Connection threads start with these blocked, so only this thread
+    // handles them.
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+
+    QueryServerState state;
+    state.index = &index;
+    state.queries_answered.store(0);
+    pthread_mutex_init(&state.mutex, nullptr);
+    pthread_cond_init(&state.all_closed, nullptr);
+
+    std::cerr << "Serving " << index.records.size() << " records on " << socket_path << "\n";
+
+    pollfd waits[2] = {{listen_fd, POLLIN, 0}, {wake_fds[0], POLLIN, 0}};
+
+    while (!query_server_stopping) {
+        // A signal after the check above still wakes this through the pipe.
+        if (poll(waits, 2, -1) == -1 || (waits[1].revents & POLLIN)
+                || !(waits[0].revents & POLLIN)) {
+            continue;
+        }
+
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd == -1) {
+            continue;
+        }
+
+        Connection_ThreadData *data = new Connection_ThreadData;
+        data->fd = fd;
+        data->state = &state;
+
+        pthread_mutex_lock(&state.mutex);
+        state.open_fds.push_back(fd);
+        pthread_mutex_unlock(&state.mutex);
+
+        sigset_t previous;
+        pthread_sigmask(SIG_BLOCK, &stop_signals, &previous);
+        pthread_t tid;
+        int created = pthread_create(&tid, nullptr, serveConnection, data);
+        pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+
+        if (created != 0) {
+            pthread_mutex_lock(&state.mutex);
+            state.open_fds.pop_back();
+            pthread_mutex_unlock(&state.mutex);
+
+            close(fd);
+            delete data;
+            continue;
+        }
+        pthread_detach(tid);
+    }
+
+    close(listen_fd);
+    unlink(socket_path.c_str());
+
+    query_server_wake_fd = -1;
+    close(wake_fds[0]);
+    close(wake_fds[1]);
+
+    // Wakes every connection thread out of its read() so they all finish.
+    pthread_mutex_lock(&state.mutex);
+    for (size_t i = 0; i < state.open_fds.size(); i++) {
+        shutdown(state.open_fds[i], SHUT_RDWR);
+    }
+    while (!state.open_fds.empty()) {
+        pthread_cond_wait(&state.all_closed, &state.mutex);
+    }
+    pthread_mutex_unlock(&state.mutex);
+
+    pthread_mutex_destroy(&state.mutex);
+    pthread_cond_destroy(&state.all_closed);
+
+    std::cerr << "Answered " << state.queries_answered.load() << " queries\n";
+    return true;
+}
+
+#endif
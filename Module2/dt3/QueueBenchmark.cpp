@@ -0,0 +1,284 @@
+// ----------------------------------------------------------------------------
+// File:        QueueBenchmark.cpp
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Thread count scaling benchmark of the channel between the
+//              simulator's producer and consumer threads: the std::queue of
+//              BUFF_SIZE records behind one mutex with broadcast condition
+//              variables, the same queue with targeted, watermark batched
+//              wakeups (EventCount.h), and the lock-free ring buffer in
+//              RingBuffer.h.
+//
+//              Each is also reported as context switches (voluntary and
+//              involuntary, from getrusage()) per record moved.
+//
+//              Half of the threads (rounded down, at least 1) produce and
+//              the rest consume, the same split as the simulator.
+//
+//              Afterwards the targeted queue is run with a capacity of 1 and
+//              2 and many producers, which used to strand sleeping producers
+//              when the data ran out.
+//
+//              Usage: ./queue_benchmark [records] [max threads]
+//
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+#include <chrono>
+#include <queue>
+#include <vector>
+#include <atomic>
+#include <iomanip>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "TrafficData.h"
+#include "RingBuffer.h"
+#include "EventCount.h"
+
+using namespace std::chrono;
+using namespace std;
+
+const long NUM_CORES = sysconf(_SC_NPROCESSORS_ONLN);
+const int BUFF_SIZE = 100;
+
+// Shared by all the threads of one run.
+struct Channel {
+    queue<TrafficLightRecord> buffer;
+    pthread_mutex_t mutex;
+    pthread_cond_t buff_has_task;
+    pthread_cond_t buff_has_space;
+
+    // Set for targeted wakeups instead of the condition variables.
+    QueueSignals *signals;
+
+    size_t capacity;
+
+    RingBuffer<TrafficLightRecord> ring;
+
+    atomic<int> producers_left;
+    int num_consumers;
+    long records_per_producer;
+
+    // The queue producers share one source, like the simulator's file.
+    long next_record;
+    long num_records;
+};
+
+// Pops a record the way the simulator's consume() does.
+TrafficLightRecord queuePop(Channel *channel) {
+    pthread_mutex_lock(&channel->mutex);
+    while (channel->buffer.empty()) {
+        if (channel->signals != nullptr) {
+            eventWait(channel->signals->has_task, &channel->mutex);
+        }
+        else {
+            pthread_cond_wait(&channel->buff_has_task, &channel->mutex);
+        }
+    }
+    TrafficLightRecord record = channel->buffer.front();
+    channel->buffer.pop();
+
+    if (channel->signals != nullptr) {
+        notifyPopped(*channel->signals, channel->buffer.size(), channel->capacity);
+    }
+    else {
+        pthread_cond_broadcast(&channel->buff_has_space);
+    }
+    pthread_mutex_unlock(&channel->mutex);
+    return record;
+}
+
+// Pushes records the way the simulator's produce() does, so a producer only
+// finds the records have run out after waiting for space.
+void *queueProducer(void *arg) {
+    Channel *channel = static_cast<Channel *>(arg);
+
+    while (true) {
+        pthread_mutex_lock(&channel->mutex);
+        while (channel->buffer.size() >= channel->capacity) {
+            if (channel->signals != nullptr) {
+                eventWait(channel->signals->has_space, &channel->mutex);
+            }
+            else {
+                pthread_cond_wait(&channel->buff_has_space, &channel->mutex);
+            }
+        }
+
+        if (channel->next_record == channel->num_records) {
+            // The end of data records wake every consumer.
+            if (channel->producers_left.fetch_sub(1) == 1) {
+                TrafficLightRecord silly_record = {-1, -1, -1};
+                for (int i = 0; i < channel->num_consumers; i++) {
+                    channel->buffer.push(silly_record);
+                }
+
+                if (channel->signals != nullptr) {
+                    eventNotify(channel->signals->has_task, channel->num_consumers);
+                }
+                else {
+                    pthread_cond_broadcast(&channel->buff_has_task);
+                }
+            }
+
+            if (channel->signals != nullptr) {
+                notifyProducerExit(*channel->signals);
+            }
+            pthread_mutex_unlock(&channel->mutex);
+            break;
+        }
+
+        TrafficLightRecord record = {800, static_cast<int>(channel->next_record++), 1};
+        channel->buffer.push(record);
+
+        if (channel->signals != nullptr) {
+            notifyPushed(*channel->signals, channel->buffer.size());
+        }
+        else {
+            pthread_cond_broadcast(&channel->buff_has_task);
+        }
+        pthread_mutex_unlock(&channel->mutex);
+    }
+
+    pthread_exit(nullptr);
+}
+
+void *queueConsumer(void *arg) {
+    Channel *channel = static_cast<Channel *>(arg);
+
+    while (queuePop(channel).time != -1) {
+    }
+
+    pthread_exit(nullptr);
+}
+
+void *ringProducer(void *arg) {
+    Channel *channel = static_cast<Channel *>(arg);
+
+    for (long i = 0; i < channel->records_per_producer; i++) {
+        TrafficLightRecord record = {800, static_cast<int>(i), 1};
+        ringPush(channel->ring, record);
+    }
+
+    if (channel->producers_left.fetch_sub(1) == 1) {
+        TrafficLightRecord silly_record = {-1, -1, -1};
+        for (int i = 0; i < channel->num_consumers; i++) {
+            ringPush(channel->ring, silly_record);
+        }
+    }
+
+    pthread_exit(nullptr);
+}
+
+void *ringConsumer(void *arg) {
+    Channel *channel = static_cast<Channel *>(arg);
+
+    TrafficLightRecord record;
+    do {
+        ringPop(channel->ring, record);
+    } while (record.time != -1);
+
+    pthread_exit(nullptr);
+}
+
+long contextSwitches() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+// Moves num_records records through the channel ("queue", "targeted" or
+// "ring") of capacity records with num_threads threads.
+//
+// Returns records per second, and the context switches per record in
+// switches_per_record.
+double runChannel(const string &kind, long num_records, int num_threads,
+                    double &switches_per_record, size_t capacity = BUFF_SIZE) {
+    bool use_ring = (kind == "ring");
+    int num_producers = max(1, num_threads / 2);
+    int num_consumers = max(1, num_threads - num_threads / 2);
+
+    Channel channel;
+    pthread_mutex_init(&channel.mutex, nullptr);
+    pthread_cond_init(&channel.buff_has_task, nullptr);
+    pthread_cond_init(&channel.buff_has_space, nullptr);
+    channel.capacity = capacity;
+    ringInit(channel.ring, capacity);
+
+    QueueSignals signals;
+    initQueueSignals(signals, capacity);
+    channel.signals = (kind == "targeted") ? &signals : nullptr;
+    channel.producers_left = num_producers;
+    channel.num_consumers = num_consumers;
+    channel.records_per_producer = num_records / num_producers;
+    channel.next_record = 0;
+    channel.num_records = channel.records_per_producer * num_producers;
+
+    vector<pthread_t> tid(num_producers + num_consumers);
+
+    long switches_before = contextSwitches();
+    auto start = high_resolution_clock::now();
+
+    for (int i = 0; i < num_producers; i++) {
+        pthread_create(&tid[i], nullptr,
+                        use_ring ? ringProducer : queueProducer, &channel);
+    }
+    for (int i = num_producers; i < num_producers + num_consumers; i++) {
+        pthread_create(&tid[i], nullptr,
+                        use_ring ? ringConsumer : queueConsumer, &channel);
+    }
+    for (size_t i = 0; i < tid.size(); i++) {
+        pthread_join(tid[i], nullptr);
+    }
+
+    auto stop = high_resolution_clock::now();
+    long switches = contextSwitches() - switches_before;
+
+    ringDestroy(channel.ring);
+    pthread_mutex_destroy(&channel.mutex);
+    pthread_cond_destroy(&channel.buff_has_task);
+    pthread_cond_destroy(&channel.buff_has_space);
+
+    double seconds = duration_cast<duration<double>>(stop - start).count();
+    double records = channel.records_per_producer * num_producers;
+    switches_per_record = switches / records;
+    return records / seconds;
+}
+
+int main(int argc, char *argv[]) {
+    long num_records = (argc > 1) ? atol(argv[1]) : 2000000;
+    int max_threads = (argc > 2) ? atoi(argv[2]) : 2 * NUM_CORES;
+
+    cout << "threads,queue_records_per_s,targeted_records_per_s,ring_records_per_s,"
+        << "speed_increase,queue_switches_per_record,targeted_switches_per_record,"
+        << "ring_switches_per_record\n";
+
+    for (int threads = 2; threads <= max(2, max_threads); threads *= 2) {
+        double queue_switches, targeted_switches, ring_switches;
+        double queue_rate = runChannel("queue", num_records, threads, queue_switches);
+        double targeted_rate = runChannel("targeted", num_records, threads, targeted_switches);
+        double ring_rate = runChannel("ring", num_records, threads, ring_switches);
+
+        cout << threads << ","
+            << fixed << setprecision(0) << queue_rate << ","
+            << targeted_rate << ","
+            << ring_rate << ","
+            << setprecision(2) << ring_rate / queue_rate << ","
+            << setprecision(4) << queue_switches << ","
+            << targeted_switches << ","
+            << ring_switches << "\n";
+    }
+
+    // Hangs if a producer leaves without passing on a wakeup it was given.
+    for (size_t capacity = 1; capacity <= 2; capacity++) {
+        double switches;
+        runChannel("targeted", num_records / 10, 32, switches, capacity);
+        cerr << "targeted, capacity " << capacity << ", 16 producers: finished\n";
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,155 @@
+// ----------------------------------------------------------------------------
+// File:        RangeSums.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Congestion over any range of the day (07:45 to 09:15 say), not
+//              just whole hours.
+//
+//              The data has one record per light every 15 minutes, so the day
+//              is split into 96 slots and each light gets a running total of
+//              its cars over them: prefix[s] is the cars passed before slot
+//              s. The cars a light passed over slots [a, b) is then
+//              prefix[b] - prefix[a], so a range query is O(lights) with no
+//              rescan of the records.
+//
+//              A slot is in a range if the time it starts at is, so
+//              0745-0915 is the slots starting 07:45 through 09:00.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef RANGE_SUMS_H
+#define RANGE_SUMS_H
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "TrafficData.h"
+
+const int MINUTES_PER_SLOT = 15;
+const int SLOTS_PER_DAY = HOURS_PER_DAY * 60 / MINUTES_PER_SLOT;
+
+// Every light's running totals. Light i is ids[i] (in increasing order) and
+// its totals are prefix[i * (SLOTS_PER_DAY + 1)] onwards.
+struct RangeSums {
+    std::vector<int> ids;
+    std::vector<long long> prefix;
+};
+
+// Returns the minute of the day of a 24 hr time, or -1 if it isn't in
+// [0000, 2400] (2400 is allowed as the end of a range).
+inline int timeToMinute(int time) {
+    int hr = time / 100, min = time % 100;
+    if (time < 0 || min >= 60 || hr > HOURS_PER_DAY || (hr == HOURS_PER_DAY && min > 0)) {
+        return -1;
+    }
+    return hr * 60 + min;
+}
+
+// Returns the 15 minute slot a record is in, or -1 if its time isn't a time
+// of day.
+inline int recordSlot(const TrafficLightRecord &record) {
+    int minute = timeToMinute(record.time);
+    return (minute == -1 || minute >= HOURS_PER_DAY * 60) ? -1 : minute / MINUTES_PER_SLOT;
+}
+
+// Parses a "HHMM-HHMM" range into the slots [start_slot, end_slot) that
+// start inside it.
+//
+// Returns false if it isn't two times with the first before the second.
+inline bool parseTimeRange(const std::string &range, int &start_slot, int &end_slot) {
+    size_t dash = range.find('-');
+    if (dash == 0 || dash == std::string::npos || dash + 1 == range.size()
+            || range.find_first_not_of("0123456789-") != std::string::npos
+            || range.find('-', dash + 1) != std::string::npos) {
+        return false;
+    }
+
+    int start = timeToMinute(atoi(range.substr(0, dash).c_str()));
+    int end = timeToMinute(atoi(range.substr(dash + 1).c_str()));
+    if (start == -1 || end == -1 || start >= end) {
+        return false;
+    }
+
+    // Rounding up means a slot is only included if it starts in the range.
+    start_slot = (start + MINUTES_PER_SLOT - 1) / MINUTES_PER_SLOT;
+    end_slot = (end + MINUTES_PER_SLOT - 1) / MINUTES_PER_SLOT;
+    return true;
+}
+
+// Builds sums from every record. Records whose time isn't a time of day are
+// left out.
+inline void buildRangeSums(const std::vector<TrafficLightRecord> &records, RangeSums &sums) {
+    sums.ids.resize(records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        sums.ids[i] = records[i].id;
+    }
+    sort(sums.ids.begin(), sums.ids.end());
+    sums.ids.erase(unique(sums.ids.begin(), sums.ids.end()), sums.ids.end());
+
+    const size_t stride = SLOTS_PER_DAY + 1;
+    sums.prefix.assign(sums.ids.size() * stride, 0);
+
+    // Each slot's cars go in at prefix[slot + 1] first, then the running
+    // totals are taken.
+    for (size_t i = 0; i < records.size(); i++) {
+        int slot = recordSlot(records[i]);
+        if (slot == -1) {
+            continue;
+        }
+
+        size_t light = lower_bound(sums.ids.begin(), sums.ids.end(), records[i].id)
+                        - sums.ids.begin();
+        sums.prefix[light * stride + slot + 1] += records[i].cars;
+    }
+
+    for (size_t light = 0; light < sums.ids.size(); light++) {
+        long long *totals = &sums.prefix[light * stride];
+        for (int slot = 1; slot <= SLOTS_PER_DAY; slot++) {
+            totals[slot] += totals[slot - 1];
+        }
+    }
+}
+
+// Returns the cars light (an index into sums.ids) passed over the slots
+// [start_slot, end_slot).
+inline long long rangeTotal(const RangeSums &sums, size_t light, int start_slot,
+                                int end_slot) {
+    const long long *totals = &sums.prefix[light * (SLOTS_PER_DAY + 1)];
+    return totals[end_slot] - totals[start_slot];
+}
+
+// Finds the cars the light with the given id passed over [start_slot,
+// end_slot).
+//
+// Returns false if there is no light with that id.
+inline bool lightRangeTotal(const RangeSums &sums, int id, int start_slot, int end_slot,
+                                long long &total) {
+    std::vector<int>::const_iterator it = lower_bound(sums.ids.begin(), sums.ids.end(), id);
+    if (it == sums.ids.end() || *it != id) {
+        return false;
+    }
+
+    total = rangeTotal(sums, it - sums.ids.begin(), start_slot, end_slot);
+    return true;
+}
+
+// Returns the N lights that passed the most cars over [start_slot,
+// end_slot), in increasing order of cars like mostCongestion(). Fewer than
+// N are returned if there aren't that many lights.
+inline std::vector<LightTotal> mostCongestedRange(const RangeSums &sums, int start_slot,
+                                                    int end_slot, int N) {
+    std::vector<LightTotal> totals(sums.ids.size());
+    for (size_t light = 0; light < sums.ids.size(); light++) {
+        totals[light].id = sums.ids[light];
+        totals[light].cars = rangeTotal(sums, light, start_slot, end_slot);
+    }
+
+    return topNLightTotals(totals, N);
+}
+
+#endif
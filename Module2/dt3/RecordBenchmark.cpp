@@ -0,0 +1,174 @@
+// ----------------------------------------------------------------------------
+// File:        RecordBenchmark.cpp
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Memory and throughput of the 12 byte TrafficLightRecord against
+//              the 8 byte PackedRecord through each stage of the simulator:
+//              the ring buffer between one producer and one consumer, sorting
+//              into hour buckets, building the HourIndex, and answering a top
+//              N query for every hour.
+//
+//              The records are generated (a random light and 15 minute slot
+//              each), and every query's cars are checked to be the same for
+//              both record types.
+//
+//              Usage: ./record_benchmark [records] [N]
+//
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <iomanip>
+#include <string>
+#include <pthread.h>
+
+#include "TrafficData.h"
+#include "PackedRecord.h"
+#include "RingBuffer.h"
+#include "HourIndex.h"
+
+using namespace std::chrono;
+using namespace std;
+
+const int BUFF_SIZE = 1024;
+
+// The records of one run and the ring they go through.
+template <typename Record>
+struct RecordChannel {
+    const vector<Record> *records;
+    vector<Record> received;
+    RingBuffer<Record> ring;
+};
+
+template <typename Record>
+void *channelProducer(void *arg) {
+    RecordChannel<Record> *channel = static_cast<RecordChannel<Record> *>(arg);
+
+    for (size_t i = 0; i < channel->records->size(); i++) {
+        ringPush(channel->ring, (*channel->records)[i]);
+    }
+
+    pthread_exit(nullptr);
+}
+
+template <typename Record>
+void *channelConsumer(void *arg) {
+    RecordChannel<Record> *channel = static_cast<RecordChannel<Record> *>(arg);
+
+    for (size_t i = 0; i < channel->received.size(); i++) {
+        ringPop(channel->ring, channel->received[i]);
+    }
+
+    pthread_exit(nullptr);
+}
+
+double secondsSince(high_resolution_clock::time_point start) {
+    return duration_cast<duration<double>>(high_resolution_clock::now() - start).count();
+}
+
+vector<TrafficLightRecord> generateRecords(size_t num_records) {
+    mt19937 rng(315);
+    uniform_int_distribution<int> random_id(0, 999999);
+    uniform_int_distribution<int> random_slot(0, HOURS_PER_DAY * 4 - 1);
+    uniform_int_distribution<int> random_cars(0, 100000);
+
+    vector<TrafficLightRecord> records(num_records);
+    for (size_t i = 0; i < num_records; i++) {
+        int slot = random_slot(rng);
+        records[i].time = (slot / 4) * 100 + (slot % 4) * 15;
+        records[i].id = random_id(rng);
+        records[i].cars = random_cars(rng);
+    }
+    return records;
+}
+
+int recordCars(const TrafficLightRecord &record) {
+    return record.cars;
+}
+
+int recordCars(const PackedRecord &record) {
+    return packedCars(record);
+}
+
+// Runs every stage on records, printing a CSV row and adding each hour's
+// ranked cars to cars_per_hour.
+template <typename Record>
+void runStages(const string &name, const vector<Record> &records, int N,
+                    vector<long long> &cars_per_hour) {
+    RecordChannel<Record> channel;
+    channel.records = &records;
+    channel.received.resize(records.size());
+    ringInit(channel.ring, BUFF_SIZE);
+
+    pthread_t tid[2];
+    auto start = high_resolution_clock::now();
+    pthread_create(&tid[0], nullptr, channelProducer<Record>, &channel);
+    pthread_create(&tid[1], nullptr, channelConsumer<Record>, &channel);
+    pthread_join(tid[0], nullptr);
+    pthread_join(tid[1], nullptr);
+    double channel_seconds = secondsSince(start);
+    ringDestroy(channel.ring);
+
+    start = high_resolution_clock::now();
+    HourBucketsOf<Record> buckets;
+    for (size_t i = 0; i < channel.received.size(); i++) {
+        addToBuckets(buckets, channel.received[i]);
+    }
+    double bucket_seconds = secondsSince(start);
+
+    start = high_resolution_clock::now();
+    HourIndexOf<Record> index;
+    buildHourIndex(&buckets, 1, index);
+    double index_seconds = secondsSince(start);
+
+    start = high_resolution_clock::now();
+    cars_per_hour.assign(HOURS_PER_DAY, 0);
+    for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+        vector<Record> congested = mostCongestion(index, hr, N);
+        for (size_t i = 0; i < congested.size(); i++) {
+            cars_per_hour[hr] += recordCars(congested[i]);
+        }
+    }
+    double query_seconds = secondsSince(start);
+
+    // The buckets and the index each hold every record at the peak.
+    double store_mb = 2.0 * records.size() * sizeof(Record) / (1024 * 1024);
+
+    cout << name << "," << sizeof(Record) << "," << sizeof(RingSlot<Record>) << ","
+        << fixed << setprecision(1) << store_mb << ","
+        << setprecision(0) << records.size() / channel_seconds << ","
+        << records.size() / bucket_seconds << ","
+        << records.size() / index_seconds << ","
+        << setprecision(1) << query_seconds * 1e6 / HOURS_PER_DAY << "\n";
+}
+
+int main(int argc, char *argv[]) {
+    size_t num_records = (argc > 1) ? atol(argv[1]) : 20000000;
+    int N = (argc > 2) ? atoi(argv[2]) : 10;
+
+    vector<TrafficLightRecord> records = generateRecords(num_records);
+
+    vector<PackedRecord> packed(records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        packRecord(records[i], packed[i]);
+    }
+
+    cout << "record,bytes_per_record,ring_slot_bytes,store_mb,channel_records_per_s,"
+        << "bucket_records_per_s,index_records_per_s,query_us_per_hour\n";
+
+    vector<long long> full_cars, packed_cars;
+    runStages("full", records, N, full_cars);
+    runStages("packed", packed, N, packed_cars);
+
+    if (full_cars != packed_cars) {
+        cerr << "The packed rankings don't match\n";
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
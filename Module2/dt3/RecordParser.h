@@ -0,0 +1,206 @@
+// ----------------------------------------------------------------------------
+// File:        RecordParser.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              A parser for the fixed "HHMM id cars" line format of the data
+//              file that avoids std::istringstream entirely.
+//
+//              Numbers are converted 8 characters at a time with SWAR (SIMD
+//              within a register): the characters are loaded into one 64 bit
+//              integer, the digit run length is found with a few bit tricks
+//              and the digits are combined pairwise with three multiplies,
+//              instead of a multiply and branch per character. Line ends are
+//              found with memchr(), which glibc vectorises, so the buffer is
+//              scanned for delimiters in bulk.
+//
+//              Malformed lines are skipped and their byte offsets reported so
+//              bad input can be found in the file.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef RECORD_PARSER_H
+#define RECORD_PARSER_H
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "TrafficData.h"
+
+const uint64_t SWAR_ZEROS = 0x3030303030303030ULL;
+const uint64_t SWAR_SIXES = 0x0606060606060606ULL;
+const uint64_t SWAR_HIGH_NIBBLES = 0xF0F0F0F0F0F0F0F0ULL;
+
+// Converts the digits in [cursor, end) one at a time. Used near the end of
+// the buffer where 8 bytes can't be loaded, and for numbers longer than 8
+// digits.
+//
+// Returns false if there are no digits or the value doesn't fit in an int.
+inline bool parseDigitsScalar(const char *&cursor, const char *end, long long value,
+                                bool have_digits, int &result) {
+    while (cursor < end && (unsigned char)(*cursor - '0') <= 9) {
+        value = value * 10 + (*cursor - '0');
+        if (value > INT_MAX) {
+            return false;
+        }
+        have_digits = true;
+        cursor++;
+    }
+
+    result = static_cast<int>(value);
+    return have_digits;
+}
+
+// Converts the run of digits at cursor to an int and moves cursor past it.
+//
+// Returns false if there are no digits or the value doesn't fit in an int.
+inline bool parseDigits(const char *&cursor, const char *end, int &result) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (end - cursor >= 8) {
+        uint64_t chunk;
+        memcpy(&chunk, cursor, 8);
+
+        // After the xor a digit byte holds its value (0 to 9). Adding 6 makes
+        // any byte with a value over 9 carry into its high nibble, so a byte
+        // is a digit only if both high nibbles are clear. The first character
+        // is in the lowest byte, so the trailing zero bits give the number of
+        // leading digits. Carries only move towards later characters, so they
+        // can't hide the first non-digit.
+        uint64_t values = chunk ^ SWAR_ZEROS;
+        uint64_t non_digits = (values | (values + SWAR_SIXES)) & SWAR_HIGH_NIBBLES;
+        int len = (non_digits == 0) ? 8 : __builtin_ctzll(non_digits) / 8;
+
+        if (len == 0) {
+            return false;
+        }
+
+        // Shifting the digits up to the top of the register puts zero bytes
+        // (leading zeros) below them, then neighbouring digits, pairs and
+        // quads are combined into one value.
+        uint64_t digits = values << (8 * (8 - len));
+        digits = (digits * 10 + (digits >> 8)) & 0x00FF00FF00FF00FFULL;
+        digits = (digits * 100 + (digits >> 16)) & 0x0000FFFF0000FFFFULL;
+        digits = (digits * 10000 + (digits >> 32)) & 0x00000000FFFFFFFFULL;
+
+        cursor += len;
+
+        if (len == 8) {
+            // There may be more digits than fit in one load.
+            return parseDigitsScalar(cursor, end, digits, true, result);
+        }
+
+        result = static_cast<int>(digits);
+        return true;
+    }
+#endif
+
+    return parseDigitsScalar(cursor, end, 0, false, result);
+}
+
+// Moves cursor past any spaces or tabs.
+//
+// Returns true if at least one was skipped.
+inline bool skipBlanks(const char *&cursor, const char *end) {
+    const char *start = cursor;
+    while (cursor < end && (*cursor == ' ' || *cursor == '\t')) {
+        cursor++;
+    }
+    return cursor != start;
+}
+
+// Parses a single line (without its '\n') into record.
+//
+// buffer_end is how far it is safe to read, so numbers near the end of the
+// line can still be loaded 8 bytes at a time. A digit run always stops at
+// the '\n' so nothing past line_end is ever parsed.
+//
+// Returns false if the line isn't three integers separated by blanks.
+inline bool parseRecordLine(const char *line, const char *line_end,
+                                TrafficLightRecord &record,
+                                const char *buffer_end = nullptr) {
+    const char *cursor = line;
+    const char *load_end = (buffer_end != nullptr) ? buffer_end : line_end;
+
+    skipBlanks(cursor, line_end);
+    bool valid = parseDigits(cursor, load_end, record.time)
+                    && skipBlanks(cursor, line_end)
+                    && parseDigits(cursor, load_end, record.id)
+                    && skipBlanks(cursor, line_end)
+                    && parseDigits(cursor, load_end, record.cars);
+
+    // Trailing blanks and Windows line endings are allowed.
+    while (valid && cursor < line_end
+            && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r')) {
+        cursor++;
+    }
+
+    return valid && cursor == line_end;
+}
+
+// Returns true if [line, line_end) has nothing but whitespace. These lines
+// are skipped without being reported as malformed.
+inline bool isBlankLine(const char *line, const char *line_end) {
+    while (line < line_end) {
+        if (*line != ' ' && *line != '\t' && *line != '\r') {
+            return false;
+        }
+        line++;
+    }
+    return true;
+}
+
+// Parses every line in [begin, end) and appends the records to records.
+//
+// If at_eof is false the buffer is assumed to be cut off part way through
+// the file, so a final line without a '\n' is left unparsed for the caller
+// to carry over into the next buffer.
+//
+// The byte offsets (base_offset plus the position in the buffer) of lines
+// that couldn't be parsed are appended to malformed when it isn't null.
+//
+// Returns a pointer to the first byte that wasn't consumed.
+inline const char *parseRecordBuffer(const char *begin, const char *end, bool at_eof,
+                                        std::vector<TrafficLightRecord> &records,
+                                        std::vector<size_t> *malformed = nullptr,
+                                        size_t base_offset = 0) {
+    // Lines in the data file are about 16 bytes, reserving up front avoids
+    // most reallocations while appending. The capacity is at least doubled
+    // so that parsing a file one buffer at a time doesn't reallocate every
+    // call.
+    size_t expected = records.size() + (end - begin) / 16;
+    if (expected > records.capacity()) {
+        records.reserve(std::max(expected, 2 * records.capacity()));
+    }
+
+    const char *line = begin;
+    while (line < end) {
+        const char *line_end = static_cast<const char *>(memchr(line, '\n', end - line));
+
+        if (line_end == nullptr) {
+            if (!at_eof) {
+                break;
+            }
+            line_end = end;
+        }
+
+        TrafficLightRecord record;
+        if (parseRecordLine(line, line_end, record, end)) {
+            records.push_back(record);
+        }
+        else if (malformed != nullptr && !isBlankLine(line, line_end)) {
+            malformed->push_back(base_offset + (line - begin));
+        }
+
+        line = (line_end < end) ? line_end + 1 : end;
+    }
+
+    return line;
+}
+
+#endif
@@ -0,0 +1,266 @@
+// ----------------------------------------------------------------------------
+// File:        RingBuffer.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              A lock-free bounded multi-producer/multi-consumer ring buffer
+//              of fixed-size slots, as an alternative to the mutex protected
+//              std::queue the simulator's threads share.
+//
+//              Each slot has a sequence number that says whose turn it is to
+//              use it (D. Vyukov's bounded MPMC queue), so producers and
+//              consumers only contend on a compare-and-swap of the head or
+//              tail index instead of a single mutex.
+//
+//              When the ring is full or empty a thread spins for a short
+//              while and then parks on a futex. A push or pop only makes a
+//              system call if a thread on the other side is asleep and no one
+//              has woken it yet, and then it wakes just that one thread, so
+//              there are no broadcasts.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// How many times to retry before parking on a futex. Spinning can't help
+// on a single core because the thread we are waiting on can't run, so then
+// we park straight away.
+const int RING_SPIN_LIMIT = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? 200 : 0;
+
+template <typename T>
+struct RingSlot {
+    std::atomic<size_t> sequence;
+    T value;
+};
+
+// Head, tail and the wait words are each given their own cache line so
+// producers and consumers don't invalidate each other's lines.
+template <typename T>
+struct RingBuffer {
+    RingSlot<T> *slots;
+    size_t mask;
+
+    alignas(64) std::atomic<size_t> head;   // Next slot to push to.
+    alignas(64) std::atomic<size_t> tail;   // Next slot to pop from.
+
+    // Futex words that are bumped whenever a sleeping thread needs waking,
+    // and the sleeper counts for each (see RING_WAITER).
+    alignas(64) std::atomic<int> not_empty;
+    std::atomic<uint64_t> consumers_waiting;
+    alignas(64) std::atomic<int> not_full;
+    std::atomic<uint64_t> producers_waiting;
+};
+
+// A sleeper count holds the number of threads parked in its low 32 bits and
+// how many of them have already been sent a wake up in its high 32 bits, so
+// a push or pop only wakes a thread that no one else has woken yet.
+const uint64_t RING_WAITER = 1;
+const uint64_t RING_WOKEN = 1ULL << 32;
+
+inline void futexWait(std::atomic<int> *word, int expected) {
+    syscall(SYS_futex, reinterpret_cast<int *>(word), FUTEX_WAIT_PRIVATE,
+                expected, nullptr, nullptr, 0);
+}
+
+inline void futexWake(std::atomic<int> *word, int count) {
+    syscall(SYS_futex, reinterpret_cast<int *>(word), FUTEX_WAKE_PRIVATE,
+                count, nullptr, nullptr, 0);
+}
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// Sets up ring with room for at least capacity items. The capacity is rounded
+// up to a power of 2 so slot indices can be masked instead of divided.
+template <typename T>
+void ringInit(RingBuffer<T> &ring, size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size *= 2;
+    }
+
+    ring.slots = new RingSlot<T>[size];
+    ring.mask = size - 1;
+    for (size_t i = 0; i < size; i++) {
+        ring.slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    ring.head.store(0, std::memory_order_relaxed);
+    ring.tail.store(0, std::memory_order_relaxed);
+    ring.not_empty.store(0, std::memory_order_relaxed);
+    ring.consumers_waiting.store(0, std::memory_order_relaxed);
+    ring.not_full.store(0, std::memory_order_relaxed);
+    ring.producers_waiting.store(0, std::memory_order_relaxed);
+}
+
+template <typename T>
+void ringDestroy(RingBuffer<T> &ring) {
+    delete[] ring.slots;
+    ring.slots = nullptr;
+}
+
+// Wakes one thread parked on word, if any are that haven't been woken yet.
+inline void ringNotify(std::atomic<int> &word, std::atomic<uint64_t> &waiting) {
+    // Pairs with the fence in ringPark(): either the parking thread sees the
+    // slot we just changed, or we see that it is waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    uint64_t count = waiting.load(std::memory_order_relaxed);
+    while ((count & 0xFFFFFFFF) > (count >> 32)) {
+        if (waiting.compare_exchange_weak(count, count + RING_WOKEN,
+                                            std::memory_order_relaxed)) {
+            word.fetch_add(1, std::memory_order_release);
+            futexWake(&word, 1);
+            return;
+        }
+    }
+}
+
+// Takes a thread that has stopped waiting off the sleeper count, along with
+// one of the wake ups if there are any.
+//
+// We can't tell whether the wake up was meant for us, but a wake up sent
+// after a thread started waiting always makes it return (the futex word
+// will have changed), so at worst another thread is woken again later.
+inline void ringUnpark(std::atomic<uint64_t> &waiting) {
+    uint64_t count = waiting.load(std::memory_order_relaxed);
+    while (true) {
+        uint64_t next = count - RING_WAITER;
+        if ((count >> 32) > 0) {
+            next -= RING_WOKEN;
+        }
+        if (waiting.compare_exchange_weak(count, next, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+// Returns false instead of blocking if the ring is full.
+template <typename T>
+bool ringTryPush(RingBuffer<T> &ring, const T &value) {
+    size_t pos = ring.head.load(std::memory_order_relaxed);
+
+    while (true) {
+        RingSlot<T> &slot = ring.slots[pos & ring.mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        long diff = static_cast<long>(sequence) - static_cast<long>(pos);
+
+        if (diff == 0) {
+            // The slot is free for this lap, claim it by moving head on.
+            if (ring.head.compare_exchange_weak(pos, pos + 1,
+                                                std::memory_order_relaxed)) {
+                slot.value = value;
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                ringNotify(ring.not_empty, ring.consumers_waiting);
+                return true;
+            }
+        }
+        else if (diff < 0) {
+            // A consumer hasn't emptied this slot from the last lap yet.
+            return false;
+        }
+        else {
+            pos = ring.head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// Returns false instead of blocking if the ring is empty.
+template <typename T>
+bool ringTryPop(RingBuffer<T> &ring, T &value) {
+    size_t pos = ring.tail.load(std::memory_order_relaxed);
+
+    while (true) {
+        RingSlot<T> &slot = ring.slots[pos & ring.mask];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        long diff = static_cast<long>(sequence) - static_cast<long>(pos + 1);
+
+        if (diff == 0) {
+            if (ring.tail.compare_exchange_weak(pos, pos + 1,
+                                                std::memory_order_relaxed)) {
+                value = slot.value;
+
+                // Frees the slot for the producers' next lap.
+                slot.sequence.store(pos + ring.mask + 1, std::memory_order_release);
+                ringNotify(ring.not_full, ring.producers_waiting);
+                return true;
+            }
+        }
+        else if (diff < 0) {
+            // No producer has filled this slot yet.
+            return false;
+        }
+        else {
+            pos = ring.tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// Sleeps on word until notified, unless attempt() succeeds after we have
+// announced that we are waiting (which closes the gap where a notify could
+// be missed).
+template <typename Attempt>
+bool ringPark(std::atomic<int> &word, std::atomic<uint64_t> &waiting, Attempt attempt) {
+    int seen = word.load(std::memory_order_acquire);
+    waiting.fetch_add(RING_WAITER, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    bool done = attempt();
+    if (!done) {
+        futexWait(&word, seen);
+    }
+
+    ringUnpark(waiting);
+    return done;
+}
+
+// Pushes value, spinning and then sleeping while the ring is full.
+template <typename T>
+void ringPush(RingBuffer<T> &ring, const T &value) {
+    while (true) {
+        for (int i = 0; i < RING_SPIN_LIMIT; i++) {
+            if (ringTryPush(ring, value)) {
+                return;
+            }
+            cpuRelax();
+        }
+
+        if (ringPark(ring.not_full, ring.producers_waiting,
+                        [&]() { return ringTryPush(ring, value); })) {
+            return;
+        }
+    }
+}
+
+// Pops into value, spinning and then sleeping while the ring is empty.
+template <typename T>
+void ringPop(RingBuffer<T> &ring, T &value) {
+    while (true) {
+        for (int i = 0; i < RING_SPIN_LIMIT; i++) {
+            if (ringTryPop(ring, value)) {
+                return;
+            }
+            cpuRelax();
+        }
+
+        if (ringPark(ring.not_empty, ring.consumers_waiting,
+                        [&]() { return ringTryPop(ring, value); })) {
+            return;
+        }
+    }
+}
+
+#endif
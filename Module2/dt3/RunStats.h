@@ -0,0 +1,112 @@
+// ----------------------------------------------------------------------------
+// File:        RunStats.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Timing of one simulator run, printed with --stats as a single
+//              JSON line on stderr (stdout still has the answer) and read back
+//              by the benchmark driver.
+//
+//              Lock wait is the time threads spent blocked acquiring the
+//              channel's mutex, summed over every thread, so it can be more
+//              than the run took.
+//
+//              Producers and consumers are only printed by the threaded
+//              engine, where --producers=auto means they aren't known until
+//              the run.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef RUN_STATS_H
+#define RUN_STATS_H
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <ostream>
+#include <iomanip>
+
+struct RunStats {
+    std::string engine;
+    long long records;
+    double ingest_seconds;      // Reading the data until it can be queried.
+    double query_seconds;
+    double lock_wait_seconds;
+    int producers;
+    int consumers;
+};
+
+inline double secondsSince(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::duration<double> >(
+                std::chrono::high_resolution_clock::now() - start).count();
+}
+
+inline void printRunStats(std::ostream &out, const RunStats &stats) {
+    double records_per_s = (stats.ingest_seconds > 0) ? stats.records / stats.ingest_seconds : 0;
+
+    out << std::fixed
+        << "{\"engine\": \"" << stats.engine << "\""
+        << ", \"records\": " << stats.records
+        << std::setprecision(6)
+        << ", \"ingest_seconds\": " << stats.ingest_seconds
+        << std::setprecision(0)
+        << ", \"ingest_records_per_s\": " << records_per_s
+        << std::setprecision(1)
+        << ", \"query_us\": " << stats.query_seconds * 1e6
+        << std::setprecision(3)
+        << ", \"lock_wait_ms\": " << stats.lock_wait_seconds * 1e3;
+
+    if (stats.producers > 0) {
+        out << ", \"producers\": " << stats.producers
+            << ", \"consumers\": " << stats.consumers;
+    }
+    out << "}\n";
+}
+
+// Reads the number after "key": in text.
+//
+// Returns false if the key isn't there.
+inline bool statsField(const std::string &text, const char *key, double &value) {
+    std::string quoted = std::string("\"") + key + "\":";
+    size_t at = text.find(quoted);
+    if (at == std::string::npos) {
+        return false;
+    }
+
+    value = strtod(text.c_str() + at + quoted.size(), nullptr);
+    return true;
+}
+
+// Reads back a line printed by printRunStats(), anywhere in text.
+//
+// Returns false if there isn't one.
+inline bool parseRunStats(const std::string &text, RunStats &stats) {
+    double records, ingest_seconds, query_us, lock_wait_ms;
+    if (!statsField(text, "records", records) || !statsField(text, "ingest_seconds", ingest_seconds)
+            || !statsField(text, "query_us", query_us)
+            || !statsField(text, "lock_wait_ms", lock_wait_ms)) {
+        return false;
+    }
+
+    size_t engine = text.find("\"engine\": \"");
+    if (engine != std::string::npos) {
+        engine += 11;
+        stats.engine = text.substr(engine, text.find('"', engine) - engine);
+    }
+
+    stats.records = static_cast<long long>(records);
+    stats.ingest_seconds = ingest_seconds;
+    stats.query_seconds = query_us / 1e6;
+    stats.lock_wait_seconds = lock_wait_ms / 1e3;
+
+    double producers = 0, consumers = 0;
+    statsField(text, "producers", producers);
+    statsField(text, "consumers", consumers);
+    stats.producers = static_cast<int>(producers);
+    stats.consumers = static_cast<int>(consumers);
+    return true;
+}
+
+#endif
@@ -18,6 +18,14 @@
 #include <sstream>
 #include <queue>
 #include <algorithm>
+#include <cstring>
+
+#include "TrafficData.h"
+#include "MappedFile.h"
+#include "TrafficBinaryFormat.h"
+#include "HourIndex.h"
+#include "RunStats.h"
+#include "AsyncReader.h"
 
 using namespace std::chrono;
 using namespace std;
@@ -32,70 +40,46 @@ const int FINISHED = -1;
 
 const int NUM_TRAFFIC_LIGHTS = 1000;
 
-struct TrafficLightRecord {
-    // Even though 24 hr times do not behave like usual base 10 numbers, they
-    // are still comparable and each consecutive minute is represented by a
-    // larger integer.
-
-    int time;
-    int id;
-    int cars;
+// Where produce() reads records from.
+//
+// In mmap input mode cursor is the position in the mapped file, otherwise it
+// is null and data_file is read with getline.
+struct DataSource {
+    ifstream *data_file;
+    const char *cursor;
+    const char *end;
 };
 
-// Comparer for use in sorting congested traffic lights.
-bool compRecord(const TrafficLightRecord r_a, const TrafficLightRecord r_b) {
-    return (r_a.cars < r_b.cars);
-}
-
-// Returns a single entry from the data file.
-// 
-// Or
+// Reads the next record from whichever input is in use.
 //
-// Returns an empty string ("") if at EOF.
-string readDataFromFile(ifstream &file) {
-    // By passing the file stream object in the file can be opened just once
-    // in main().
-
-    string line;
-
-    if (getline(file, line)) {
-        return line;
+// Returns false at EOF.
+bool nextRecord(DataSource &source, TrafficLightRecord &record) {
+    if (source.cursor != nullptr) {
+        return nextMappedRecord(source.cursor, source.end, record);
     }
-    else {
-        return "";
-    }
-}
 
-// Takes a data file entry as a string and converts it to the traffic light
-// struct.
-TrafficLightRecord stringToRecord(string in_string) {
-    TrafficLightRecord record;
-    istringstream data_string_stream(in_string);
-
-    // By using a string stream we can take each word from the string without
-    // having to do manual checking for spaces by moving through character by
-    // character.
-
-    data_string_stream >> record.time;
-    data_string_stream >> record.id;
-    data_string_stream >> record.cars;
+    string str_record = readDataFromFile(*source.data_file);
+    if (str_record.empty()) {
+        return false;
+    }
 
-    return record;
+    record = stringToRecord(str_record);
+    return true;
 }
 
 // Reads entries from the data file and places them in the queue if there
 // is space.
-void produce(ifstream &data_file, queue<TrafficLightRecord> &buffer) {
+void produce(DataSource &source, queue<TrafficLightRecord> &buffer) {
     // Checks to see if the buffer is full, and if it is, waits for 
     // it to have space.
     if (buffer.size() == BUFF_SIZE) {
         return;
     }
 
-    string str_record = readDataFromFile(data_file);
+    TrafficLightRecord record;
 
     // When all data from the file has been read.
-    if (str_record.empty()) {
+    if (!nextRecord(source, record)) {
         // A "silly" record is used to signal to all the consumers
         // that there is no data left.
         TrafficLightRecord silly_record = {-1, -1, -1};
@@ -103,13 +87,11 @@ void produce(ifstream &data_file, queue<TrafficLightRecord> &buffer) {
         return;
     }
 
-    TrafficLightRecord record = stringToRecord(str_record);
     buffer.push(record);
 }
 
-// Takes data from the queue, then places it in a records container.
-int consume(queue<TrafficLightRecord> &buffer,
-                 vector<TrafficLightRecord> &records) {
+// Takes data from the queue, then places it in the bucket for its hour.
+int consume(queue<TrafficLightRecord> &buffer, HourBuckets &buckets) {
     // Checks to see if the buffer has any tasks, if not, waits for a 
     // one.
     if (buffer.empty()) {
@@ -128,81 +110,168 @@ int consume(queue<TrafficLightRecord> &buffer,
     // After calling front() on a queue it must be popped because pop()
     // doesn't return the value removed unlike most other languages.
     buffer.pop();
-    records.push_back(record);
+    addToBuckets(buckets, record);
     return 1;
 }
 
 // Moves program back and fourth between producing and consuming.
-void run(ifstream &data_file, queue<TrafficLightRecord> &buffer,
-                    vector<TrafficLightRecord> &records) {
+void run(DataSource &source, queue<TrafficLightRecord> &buffer,
+                    HourBuckets &buckets) {
     int status = 1;
     while (status != FINISHED) {
-        produce(data_file, buffer);
-        status = consume(buffer, records);
+        produce(source, buffer);
+        status = consume(buffer, buckets);
     }
 }
 
-// Returns a vector of traffic light records with the most congestion.
+// Parses the data file into buckets a chunk at a time, while io_uring reads
+// the next chunks (see AsyncReader.h). There is no queue, each chunk's
+// records go straight into their buckets. stats.engine says whether
+// io_uring or the pread() fallback was used.
 //
-// @param N how many of the most congested lights you want data on.
-// @param hr the hour of the day that you care about.
-vector<TrafficLightRecord> mostCongestion(vector<TrafficLightRecord> &records,
-                                            int hr_start, int N) {
-    vector<TrafficLightRecord> N_most_congested_lights(N);
-    vector<TrafficLightRecord> subset;
-
-    for (int i = 0; i < records.size(); i++) {
-        int hr_val = records[i].time / 100;
-        if (hr_val >= hr_start && hr_val < hr_start + 1) {
-            subset.push_back(records[i]);
-        }
+// Returns false if the file can't be read.
+bool ingestAsync(const string &data_path, HourBuckets &buckets, RunStats &stats) {
+    AsyncReader reader;
+    if (!openAsyncReader(reader, data_path.c_str())) {
+        cerr << "Could not open " << data_path << "\n";
+        return false;
     }
+    stats.engine = reader.use_uring ? "seq_uring" : "seq_pread";
 
-    // Doing an nth_element sort is more efficient for our requirements since
-    // it puts all the elements that are greater than the element at index n
-    // in a sorted version of the vector. So we end up with all the elements
-    // we want to the right (unsorted, they are sorted separately below).
-    //
-    // It runs in O(n) time as opposed to O(nlogn) time for a whole sort.
-    nth_element(subset.begin(), subset.end() - N, subset.end(), compRecord);
+    vector<TrafficLightRecord> records;
+    const char *begin, *end;
+    bool at_eof;
+    int error;
+
+    while (nextChunk(reader, begin, end, at_eof, error)) {
+        records.clear();
+        const char *rest = parseRecordBuffer(begin, end, at_eof, records);
 
-    for (int i = subset.size() - N, j = 0; i < subset.size(), j < N; i++, j++) {
-        N_most_congested_lights[j] = subset[i];
+        for (size_t i = 0; i < records.size(); i++) {
+            addToBuckets(buckets, records[i]);
+        }
+        finishChunk(reader, rest, end);
     }
 
-    sort(N_most_congested_lights.begin(), N_most_congested_lights.end(), compRecord);
+    closeAsyncReader(reader);
 
-    return N_most_congested_lights;
+    if (error != 0) {
+        cerr << "Could not read " << data_path << ": " << strerror(error) << "\n";
+        return false;
+    }
+    return true;
 }
 
-// Returns formatted string representation of a traffic light record.
-string visualRecord(TrafficLightRecord record) {
-    string id, time, cars;
+int main(int argc, char *argv[]) {
+    // The same --input, --data and --stats options as the pthread
+    // simulator.
+    string input = "getline", data_path = "./data";
+    bool print_stats = false;
+    for (int i = 3; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--input=getline" || arg == "--input=mmap"
+                || arg == "--input=binary" || arg == "--input=uring") {
+            input = arg.substr(8);
+        }
+        else if (arg.compare(0, 7, "--data=") == 0 && arg.size() > 7) {
+            data_path = arg.substr(7);
+        }
+        else if (arg == "--stats") {
+            print_stats = true;
+        }
+        else {
+            cerr << "Unknown option: " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    // atoi() converts an "Array of characters TO an Int".
+    int N = (argc >= 3) ? atoi(argv[1]) : 0, hr = (argc >= 3) ? atoi(argv[2]) : -1;
 
-    id =   "\tID: " + to_string(record.id);
-    time = "\n\tTime: " + to_string(record.time);
-    cars = "\n\tCars Passed: " + to_string(record.cars);
+    if (argc < 3 || N < 1 || hr < 0 || hr >= HOURS_PER_DAY) {
+        cerr << "Usage: " << argv[0] << " N hr [--input=getline|mmap|binary|uring]"
+            << " [--data=path] [--stats]\n";
+        return EXIT_FAILURE;
+    }
 
-    return id + time + cars;
-}
+    RunStats stats = {"seq", 0, 0, 0, 0, 0, 0};
+    auto start = high_resolution_clock::now();
+
+    // The binary format is already grouped by hour, so instead of ingesting
+    // the whole file only the requested hour's part of the mapping is read.
+    if (input == "binary") {
+        BinaryTrafficData binary_data;
+        if (!loadBinaryData(data_path.c_str(), binary_data)) {
+            cerr << data_path << " is not a binary data file\n";
+            return EXIT_FAILURE;
+        }
+
+        vector<TrafficLightRecord> hour_records = binaryHourRecords(binary_data, hr);
+        stats.records = hour_records.size();
+        stats.ingest_seconds = secondsSince(start);
+
+        auto query_start = high_resolution_clock::now();
+        // The records are all in hour hr already, so they only need ranking.
+        vector<TrafficLightRecord> congested_lights = topNRecords(hour_records, N);
+        stats.query_seconds = secondsSince(query_start);
+
+        printMostCongested(congested_lights, N);
+        if (print_stats) {
+            printRunStats(cerr, stats);
+        }
+
+        unloadBinaryData(binary_data);
+        return EXIT_SUCCESS;
+    }
 
-int main(int argc, char *argv[]) {
-    ifstream data_file("./data");
     queue<TrafficLightRecord> buffer;
-    vector<TrafficLightRecord> records;
+    HourBuckets buckets;
 
-    run(data_file, buffer, records);
+    ifstream data_file;
+    MappedFile mapped = {nullptr, 0, -1};
+    DataSource source = {&data_file, nullptr, nullptr};
 
-    // atoi() converts an "Array of characters TO an Int".
-    int N = atoi(argv[1]), hr = atoi(argv[2]);
+    if (input == "uring") {
+        if (!ingestAsync(data_path, buckets, stats)) {
+            return EXIT_FAILURE;
+        }
+    }
+    else if (input == "mmap") {
+        if (!mapFile(data_path.c_str(), mapped)) {
+            cerr << "Could not map " << data_path << "\n";
+            return EXIT_FAILURE;
+        }
+        source.cursor = mapped.data;
+        source.end = mapped.data + mapped.size;
+    }
+    else {
+        data_file.open(data_path);
+    }
 
-    vector<TrafficLightRecord> congested_lights = mostCongestion(records, hr, N);
-    for (int i = congested_lights.size() - 1; i >= 0; i--) {
-        cout << "(" + to_string(N - i) + ")\n" 
-            << visualRecord(congested_lights[i]) << "\n\n";
+    if (input != "uring") {
+        run(source, buffer, buckets);
     }
 
-    data_file.close();
+    HourIndex index;
+    buildHourIndex(&buckets, 1, index);
+    stats.records = index.records.size();
+    stats.ingest_seconds = secondsSince(start);
+
+    auto query_start = high_resolution_clock::now();
+    vector<TrafficLightRecord> congested_lights = mostCongestion(index, hr, N);
+    stats.query_seconds = secondsSince(query_start);
+
+    printMostCongested(congested_lights, N);
+    if (print_stats) {
+        printRunStats(cerr, stats);
+    }
+
+    if (input == "mmap") {
+        unmapFile(mapped);
+    }
+    else {
+        data_file.close();
+    }
 
     return EXIT_SUCCESS;
 }
\ No newline at end of file
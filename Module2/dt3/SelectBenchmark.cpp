@@ -0,0 +1,140 @@
+// ----------------------------------------------------------------------------
+// File:        SelectBenchmark.cpp
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Thread count scaling benchmark of the top N selection for one
+//              very large hour: the single threaded copy + topNRecords() that
+//              mostCongestion() does, against parallelTopNRecords() from
+//              ParallelSelect.h.
+//
+//              The records are generated with cars from a small range so
+//              there are plenty of ties, and every run's ranking is checked
+//              to be exactly (ids and times too) the single threaded one.
+//
+//              Before timing, an hour with fewer records than N is ranked by
+//              every path (topNRecords(), parallelTopNRecords(), the
+//              streaming heaps and packed records), which must all return
+//              the whole hour in the same order.
+//
+//              Usage: ./select_benchmark [records] [N] [max threads]
+//
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <iomanip>
+#include <unistd.h>
+
+#include "TrafficData.h"
+#include "ParallelSelect.h"
+#include "TopNHeap.h"
+#include "PackedRecord.h"
+
+using namespace std::chrono;
+using namespace std;
+
+const long NUM_CORES = sysconf(_SC_NPROCESSORS_ONLN);
+
+// Records for one hour (8am), one per light.
+vector<TrafficLightRecord> generateRecords(size_t num_records) {
+    mt19937 rng(315);
+    uniform_int_distribution<int> random_quarter(0, 3);
+    uniform_int_distribution<int> random_cars(0, 100000);
+
+    vector<TrafficLightRecord> records(num_records);
+    for (size_t i = 0; i < num_records; i++) {
+        records[i].time = 800 + random_quarter(rng) * 15;
+        records[i].id = static_cast<int>(i);
+        records[i].cars = random_cars(rng);
+    }
+
+    shuffle(records.begin(), records.end(), rng);
+    return records;
+}
+
+bool sameRanking(const vector<TrafficLightRecord> &a, const vector<TrafficLightRecord> &b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].time != b[i].time || a[i].id != b[i].id || a[i].cars != b[i].cars) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Ranks records (all in one hour) with N above their count on every path.
+//
+// Returns true if each gives every record, in the same order.
+bool shortHourMatches(const vector<TrafficLightRecord> &records, int max_threads) {
+    int N = records.size() + 10;
+
+    vector<TrafficLightRecord> subset(records);
+    vector<TrafficLightRecord> expected = topNRecords(subset, N);
+    bool matches = (expected.size() == records.size());
+
+    for (int threads = 1; threads <= max(1, max_threads); threads *= 2) {
+        matches = matches && sameRanking(parallelTopNRecords(records.data(), records.size(), N,
+                                                                threads), expected);
+    }
+
+    TopNHeaps heaps;
+    initTopNHeaps(heaps, N);
+    vector<PackedRecord> packed(records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        addToTopN(heaps, records[i]);
+        matches = matches && packRecord(records[i], packed[i]);
+    }
+    matches = matches && sameRanking(mostCongestion(heaps, 8, N), expected);
+    matches = matches && sameRanking(unpackRecords(topNRecords(packed, N)), expected);
+
+    return matches;
+}
+
+int main(int argc, char *argv[]) {
+    size_t num_records = (argc > 1) ? atol(argv[1]) : 20000000;
+    int N = (argc > 2) ? atoi(argv[2]) : 10;
+    int max_threads = (argc > 3) ? atoi(argv[3]) : 2 * NUM_CORES;
+
+    vector<TrafficLightRecord> records = generateRecords(num_records);
+
+    vector<TrafficLightRecord> short_hour(records.begin(),
+                                            records.begin() + min<size_t>(records.size(), 1000));
+    cerr << "N above the hour's records, same ranking on every path: "
+        << (shortHourMatches(short_hour, max_threads) ? "yes" : "no") << "\n";
+
+    auto start = high_resolution_clock::now();
+
+    vector<TrafficLightRecord> subset(records);
+    vector<TrafficLightRecord> expected = topNRecords(subset, N);
+
+    double sequential_seconds = duration_cast<duration<double>>(
+                                    high_resolution_clock::now() - start).count();
+
+    cout << "records,N,threads,sequential_ms,parallel_ms,speed_increase,same_ranking\n";
+
+    for (int threads = 1; threads <= max(1, max_threads); threads *= 2) {
+        start = high_resolution_clock::now();
+
+        vector<TrafficLightRecord> ranking = parallelTopNRecords(records.data(), records.size(),
+                                                                    N, threads);
+
+        double seconds = duration_cast<duration<double>>(
+                            high_resolution_clock::now() - start).count();
+
+        cout << records.size() << "," << N << "," << threads << ","
+            << fixed << setprecision(1) << sequential_seconds * 1000 << ","
+            << seconds * 1000 << ","
+            << setprecision(2) << sequential_seconds / seconds << ","
+            << (sameRanking(ranking, expected) ? "yes" : "no") << "\n";
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,169 @@
+// ----------------------------------------------------------------------------
+// File:        SketchBenchmark.cpp
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Accuracy report for the Space-Saving sketches in
+//              HeavyHitters.h, against the exact per hour light totals from
+//              HashAggregate.h (what --aggregate ranks by).
+//
+//              Records are generated for a large number of lights (1,000,000
+//              by default), drawn from a Zipf distribution so a few lights
+//              are much busier than the rest, as on a city-wide feed. For
+//              each error setting the records are sketched with per thread
+//              sketches that are then merged, and every hour's top N is
+//              compared to the exact one:
+//
+//                  recall          exact top N lights the sketch also found.
+//                  max_over        largest estimate minus real total.
+//                  mean_rel_error  mean (estimate - real) / real.
+//                  bound           largest total cars / capacity of an hour,
+//                                  which max_over must not pass.
+//
+//              Usage: ./sketch_benchmark [records] [lights] [N] [threads]
+//
+// ----------------------------------------------------------------------------
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <iomanip>
+#include <unistd.h>
+
+#include "TrafficData.h"
+#include "HashAggregate.h"
+#include "HeavyHitters.h"
+
+using namespace std::chrono;
+using namespace std;
+
+const long NUM_CORES = sysconf(_SC_NPROCESSORS_ONLN);
+
+// Zipf exponent of how often each light has a record.
+const double LIGHT_SKEW = 1.1;
+
+// Makes num_records records over num_lights lights, with light ranks drawn
+// from a Zipf distribution. Ranks are shuffled onto ids so busy lights
+// aren't all small ids.
+vector<TrafficLightRecord> generateRecords(size_t num_records, int num_lights) {
+    mt19937 rng(315);
+    uniform_int_distribution<int> random_hr(0, HOURS_PER_DAY - 1);
+    uniform_int_distribution<int> random_quarter(0, 3);
+    uniform_int_distribution<int> random_cars(0, 100);
+    uniform_real_distribution<double> random_unit(0, 1);
+
+    // The cumulative weights of the ranks, for a binary search per record.
+    vector<double> cumulative(num_lights);
+    double sum = 0;
+    for (int rank = 0; rank < num_lights; rank++) {
+        sum += 1 / pow(rank + 1, LIGHT_SKEW);
+        cumulative[rank] = sum;
+    }
+
+    vector<int> ids(num_lights);
+    for (int id = 0; id < num_lights; id++) {
+        ids[id] = id;
+    }
+    shuffle(ids.begin(), ids.end(), rng);
+
+    vector<TrafficLightRecord> records(num_records);
+    for (size_t i = 0; i < num_records; i++) {
+        size_t rank = lower_bound(cumulative.begin(), cumulative.end(),
+                                    random_unit(rng) * sum) - cumulative.begin();
+        records[i].time = random_hr(rng) * 100 + random_quarter(rng) * 15;
+        records[i].id = ids[min(rank, ids.size() - 1)];
+        records[i].cars = random_cars(rng);
+    }
+
+    return records;
+}
+
+// Returns the exact total of a light in an hour.
+long long exactTotal(vector<AggregateTable> &partitions, int id, int hr) {
+    uint64_t key = aggregateKey(id, hr);
+    AggregateSlot &slot = aggregateFind(partitions[aggregatePartition(key, partitions.size())],
+                                        key);
+    return (slot.key == AGGREGATE_EMPTY) ? 0 : slot.cars;
+}
+
+int main(int argc, char *argv[]) {
+    size_t num_records = (argc > 1) ? atol(argv[1]) : 8000000;
+    int num_lights = (argc > 2) ? atoi(argv[2]) : 1000000;
+    int N = (argc > 3) ? atoi(argv[3]) : 10;
+    int threads = (argc > 4) ? atoi(argv[4]) : NUM_CORES;
+
+    vector<TrafficLightRecord> records = generateRecords(num_records, num_lights);
+
+    auto start = high_resolution_clock::now();
+
+    vector<AggregateTable> partitions;
+    aggregateRecords(records, threads, partitions);
+
+    double exact_seconds = duration_cast<duration<double>>(
+                            high_resolution_clock::now() - start).count();
+
+    size_t exact_bytes = 0, keys = 0;
+    for (size_t p = 0; p < partitions.size(); p++) {
+        exact_bytes += partitions[p].slots.size() * sizeof(AggregateSlot);
+        keys += partitions[p].size;
+    }
+
+    vector<LightTotal> exact_top[HOURS_PER_DAY];
+    for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+        exact_top[hr] = mostCongestedAggregate(partitions, hr, N);
+    }
+
+    cout << "records,keys,N,threads,error,capacity,exact_records_per_s,sketch_records_per_s,"
+        << "exact_kb,sketch_kb,recall,max_over,mean_rel_error,bound\n";
+
+    const double errors[] = {0.01, 0.001, 0.0001};
+
+    for (size_t e = 0; e < sizeof(errors) / sizeof(errors[0]); e++) {
+        start = high_resolution_clock::now();
+
+        HeavyHitterSketches sketches;
+        sketchRecords(records, threads, errors[e], sketches);
+
+        double sketch_seconds = duration_cast<duration<double>>(
+                                high_resolution_clock::now() - start).count();
+
+        size_t found = 0, wanted = 0, estimates = 0;
+        long long max_over = 0, bound = 0;
+        double rel_error = 0;
+
+        for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+            vector<LightTotal> sketch_top = mostCongestedSketch(sketches, hr, N);
+            bound = max(bound, static_cast<long long>(sketches.hours[hr].total
+                                                        / sketches.hours[hr].capacity));
+
+            for (size_t i = 0; i < exact_top[hr].size(); i++) {
+                for (size_t j = 0; j < sketch_top.size(); j++) {
+                    found += (sketch_top[j].id == exact_top[hr][i].id);
+                }
+            }
+            wanted += exact_top[hr].size();
+
+            for (size_t j = 0; j < sketch_top.size(); j++) {
+                long long real = exactTotal(partitions, sketch_top[j].id, hr);
+                max_over = max(max_over, sketch_top[j].cars - real);
+                rel_error += (sketch_top[j].cars - real) / static_cast<double>(max(real, 1LL));
+                estimates++;
+            }
+        }
+
+        cout << records.size() << "," << keys << "," << N << "," << threads << ","
+            << errors[e] << "," << sketches.hours[0].capacity << ","
+            << fixed << setprecision(0) << records.size() / exact_seconds << ","
+            << records.size() / sketch_seconds << ","
+            << exact_bytes / 1024 << "," << threads * sketchBytes(sketches) / 1024 << ","
+            << setprecision(3) << found / static_cast<double>(max<size_t>(wanted, 1)) << ","
+            << max_over << "," << setprecision(4) << rel_error / max<size_t>(estimates, 1)
+            << "," << bound << "\n";
+        cout.unsetf(ios::fixed);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,253 @@
+// ----------------------------------------------------------------------------
+// File:        SpillPartitions.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Out-of-core storage for data files bigger than memory. Records
+//              are buffered per hour, each hour getting a 24th of a fixed
+//              budget, and an hour's buffer is appended to its partition file
+//              whenever it fills. So memory use stays the same however long
+//              the archive is.
+//
+//              A query only reads the queried hour's partition files, in
+//              budget sized chunks, through a top N heap (see TopNHeap.h).
+//
+//              Each writer (one per consumer thread) has its own files, named
+//              hour_HH.W, so no locking is needed. They go in a directory made
+//              for the run (see makeSpillDir()), so runs from the same place
+//              never share files, and it is removed after the query.
+//              Records are stored as raw TrafficLightRecords, so partitions
+//              are only read back on the machine that wrote them.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef SPILL_PARTITIONS_H
+#define SPILL_PARTITIONS_H
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "TrafficData.h"
+#include "TopNHeap.h"
+#include "BulkWriter.h"
+
+// One writer's hour partitions and the records not yet written to them.
+struct SpillPartitions {
+    std::string dir;
+    int fds[HOURS_PER_DAY];
+    std::vector<TrafficLightRecord> hours[HOURS_PER_DAY];
+    size_t hour_records;        // Records an hour buffers before spilling.
+    long long spilled;          // Records written to the files so far.
+    bool failed;                // A write failed, the partitions are incomplete.
+};
+
+inline std::string partitionPath(const std::string &dir, int hr, int writer) {
+    char name[32];
+    snprintf(name, sizeof(name), "/hour_%02d.%d", hr, writer);
+    return dir + name;
+}
+
+// Makes a new directory for a run's partitions inside parent, which is made
+// if it doesn't exist, and sets dir to its path.
+//
+// Returns false if it can't be made.
+inline bool makeSpillDir(const std::string &parent, std::string &dir) {
+    mkdir(parent.c_str(), 0755);
+
+    std::string pattern = parent + "/spill.XXXXXX";
+    std::vector<char> path(pattern.begin(), pattern.end());
+    path.push_back('\0');
+    if (mkdtemp(path.data()) == nullptr) {
+        return false;
+    }
+
+    dir = path.data();
+    return true;
+}
+
+// Deletes num_writers writers' partition files and then dir itself.
+inline void removeSpillDir(const std::string &dir, int num_writers) {
+    for (int w = 0; w < num_writers; w++) {
+        for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+            unlink(partitionPath(dir, hr, w).c_str());
+        }
+    }
+    rmdir(dir.c_str());
+}
+
+// Removes a run's spill directory (see removeSpillDir()) when it goes out of
+// scope, so it goes however the run ends. An empty path owns nothing.
+struct SpillDirGuard {
+    std::string path;
+    int num_writers = 0;
+
+    SpillDirGuard() = default;
+    SpillDirGuard(const SpillDirGuard &) = delete;
+    SpillDirGuard &operator=(const SpillDirGuard &) = delete;
+
+    ~SpillDirGuard() {
+        if (!path.empty()) {
+            removeSpillDir(path, num_writers);
+        }
+    }
+};
+
+// Creates writer's 24 partition files in dir (from makeSpillDir()).
+// budget_bytes is how much of memory its buffers may use.
+//
+// Returns false if a file can't be created.
+inline bool initSpill(SpillPartitions &spill, const std::string &dir, int writer,
+                        size_t budget_bytes) {
+    spill.dir = dir;
+    spill.hour_records = std::max<size_t>(budget_bytes / sizeof(TrafficLightRecord)
+                                            / HOURS_PER_DAY, 1);
+    spill.spilled = 0;
+    spill.failed = false;
+
+    bool opened = true;
+    for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+        spill.hours[hr].clear();
+        spill.hours[hr].reserve(spill.hour_records);
+        spill.fds[hr] = open(partitionPath(dir, hr, writer).c_str(),
+                                O_WRONLY | O_CREAT | O_EXCL, 0644);
+        opened = opened && spill.fds[hr] != -1;
+    }
+    return opened;
+}
+
+// Appends hour hr's buffered records to its partition file.
+inline void flushHour(SpillPartitions &spill, int hr) {
+    std::vector<TrafficLightRecord> &records = spill.hours[hr];
+    if (records.empty()) {
+        return;
+    }
+
+    if (!writeFully(spill.fds[hr], reinterpret_cast<const char *>(records.data()),
+                        records.size() * sizeof(TrafficLightRecord))) {
+        spill.failed = true;
+    }
+    spill.spilled += records.size();
+    records.clear();
+}
+
+// Buffers a record for its hour, spilling the hour if its buffer is full.
+//
+// Returns false (and ignores the record) if its time isn't a time of day.
+inline bool addToSpill(SpillPartitions &spill, const TrafficLightRecord &record) {
+    int hr = recordHour(record);
+    if (hr == -1) {
+        return false;
+    }
+
+    spill.hours[hr].push_back(record);
+    if (spill.hours[hr].size() >= spill.hour_records) {
+        flushHour(spill, hr);
+    }
+    return true;
+}
+
+// Writes out what is left and closes the files.
+//
+// Returns false if any write failed.
+inline bool closeSpill(SpillPartitions &spill) {
+    for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+        if (spill.fds[hr] != -1) {
+            flushHour(spill, hr);
+        }
+    }
+
+    for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+        if (spill.fds[hr] != -1) {
+            close(spill.fds[hr]);
+            spill.fds[hr] = -1;
+        }
+        std::vector<TrafficLightRecord>().swap(spill.hours[hr]);
+    }
+    return !spill.failed;
+}
+
+// mostCongestion() for spilled records, reading only hour hr's partitions
+// from num_writers writers, up to budget_bytes at a time.
+//
+// Returns false if a partition can't be read.
+//
+// @param N how many of the most congested lights you want data on.
+// @param hr the hour of the day that you care about.
+inline bool mostCongestionSpilled(const std::string &dir, int num_writers, int hr, int N,
+                                    size_t budget_bytes,
+                                    std::vector<TrafficLightRecord> &congested_lights) {
+    congested_lights.clear();
+    if (hr < 0 || hr >= HOURS_PER_DAY) {
+        return true;
+    }
+
+    TopNHeaps heaps;
+    initTopNHeaps(heaps, N);
+
+    size_t budget_records = std::max<size_t>(budget_bytes / sizeof(TrafficLightRecord), 1);
+    std::vector<TrafficLightRecord> chunk;
+
+    for (int w = 0; w < num_writers; w++) {
+        int fd = open(partitionPath(dir, hr, w).c_str(), O_RDONLY);
+        struct stat info;
+        if (fd == -1 || fstat(fd, &info) != 0) {
+            if (fd != -1) {
+                close(fd);
+            }
+            return false;
+        }
+
+        // The chunk only grows as big as the largest partition needs, so a
+        // small hour doesn't allocate the whole budget.
+        size_t file_records = info.st_size / sizeof(TrafficLightRecord) + 1;
+        if (chunk.size() < std::min(file_records, budget_records)) {
+            chunk.resize(std::min(file_records, budget_records));
+        }
+        size_t chunk_bytes = chunk.size() * sizeof(TrafficLightRecord);
+
+        // A chunk can end part way through a record, the rest of it is
+        // moved to the front before the next read.
+        size_t have = 0;
+        while (true) {
+            ssize_t got = read(fd, reinterpret_cast<char *>(chunk.data()) + have,
+                                chunk_bytes - have);
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got < 0) {
+                close(fd);
+                return false;
+            }
+            if (got == 0) {
+                break;
+            }
+
+            have += got;
+            size_t whole = have / sizeof(TrafficLightRecord);
+            for (size_t i = 0; i < whole; i++) {
+                addToTopN(heaps, chunk[i]);
+            }
+
+            size_t rest = have - whole * sizeof(TrafficLightRecord);
+            memmove(chunk.data(), reinterpret_cast<char *>(chunk.data())
+                                    + whole * sizeof(TrafficLightRecord), rest);
+            have = rest;
+        }
+        close(fd);
+    }
+
+    congested_lights = mostCongestion(heaps, hr, N);
+    return true;
+}
+
+#endif
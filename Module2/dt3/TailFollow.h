@@ -0,0 +1,265 @@
+// ----------------------------------------------------------------------------
+// File:        TailFollow.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Following a data file that is still being appended to (the
+//              feeds add a block of records every 15 minutes), like tail -f.
+//
+//              The file is read from the start once, then inotify says when
+//              it has been written to and only the bytes past the last read
+//              are parsed. Records go straight into per-hour top N heaps
+//              (see TopNHeap.h), so the current ranking is always ready and
+//              earlier data is never processed again.
+//
+//              A line that has only been partly written is held back until
+//              the rest of it arrives. If the file is truncated it is read
+//              again from the start, and following stops if it is deleted or
+//              moved.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef TAIL_FOLLOW_H
+#define TAIL_FOLLOW_H
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <string>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "TrafficData.h"
+#include "RecordParser.h"
+#include "TopNHeap.h"
+
+const size_t FOLLOW_READ_SIZE = 1 << 20;
+
+struct FollowState {
+    int fd;
+    off_t offset;                   // Bytes of the file read so far.
+    std::vector<char> pending;      // Read but not yet parsed (a partial line).
+    TopNHeaps heaps;
+    size_t num_records;
+    size_t num_malformed;
+};
+
+// Set by the signal handler to stop following.
+static volatile sig_atomic_t follow_stopping = 0;
+
+// The write end of the pipe that wakes the poll() in followFile().
+static int follow_wake_fd = -1;
+
+inline void stopFollowing(int) {
+    int saved_errno = errno;
+    follow_stopping = 1;
+    if (follow_wake_fd != -1) {
+        ssize_t ignored = write(follow_wake_fd, "", 1);
+        (void) ignored;
+    }
+    errno = saved_errno;
+}
+
+// Opens path to be followed, keeping the top N records of each hour.
+//
+// Returns false if it can't be opened.
+inline bool followOpen(const std::string &path, int N, FollowState &state) {
+    state.fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    state.offset = 0;
+    state.pending.clear();
+    state.num_records = 0;
+    state.num_malformed = 0;
+    initTopNHeaps(state.heaps, N);
+
+    return state.fd != -1;
+}
+
+inline void followClose(FollowState &state) {
+    if (state.fd != -1) {
+        close(state.fd);
+        state.fd = -1;
+    }
+}
+
+// Reads and parses everything appended to the file since the last call.
+//
+// Returns how many new records were added, or -1 on a read error.
+inline long followRead(FollowState &state) {
+    struct stat file_stat;
+    if (fstat(state.fd, &file_stat) == -1) {
+        return -1;
+    }
+
+    // Truncated (or replaced in place), so everything is read again.
+    if (file_stat.st_size < state.offset) {
+        std::cerr << "File was truncated, reading it again from the start\n";
+        state.offset = 0;
+        state.pending.clear();
+        state.num_records = 0;
+        initTopNHeaps(state.heaps, state.heaps.N);
+    }
+
+    size_t records_before = state.num_records;
+    std::vector<TrafficLightRecord> records;
+    std::vector<size_t> malformed;
+
+    while (true) {
+        size_t kept = state.pending.size();
+        state.pending.resize(kept + FOLLOW_READ_SIZE);
+
+        ssize_t n = pread(state.fd, state.pending.data() + kept, FOLLOW_READ_SIZE,
+                            state.offset);
+        if (n < 0 && errno == EINTR) {
+            state.pending.resize(kept);
+            continue;
+        }
+        if (n <= 0) {
+            state.pending.resize(kept);
+            if (n < 0) {
+                return -1;
+            }
+            break;
+        }
+
+        state.pending.resize(kept + n);
+        state.offset += n;
+
+        // A last line without its '\n' may still be being written, so it is
+        // left in pending for the next read.
+        const char *begin = state.pending.data();
+        const char *end = begin + state.pending.size();
+        records.clear();
+        const char *rest = parseRecordBuffer(begin, end, false, records, &malformed,
+                                                state.offset - state.pending.size());
+
+        for (size_t i = 0; i < records.size(); i++) {
+            addToTopN(state.heaps, records[i]);
+        }
+        state.num_records += records.size();
+
+        state.pending.erase(state.pending.begin(), state.pending.begin() + (rest - begin));
+    }
+
+    for (size_t i = 0; i < malformed.size(); i++) {
+        std::cerr << "Malformed line at byte " << malformed[i] << "\n";
+    }
+    state.num_malformed += malformed.size();
+
+    return state.num_records - records_before;
+}
+
+// Follows path until SIGINT or SIGTERM, or until the file is deleted or
+// moved. on_update(state) is called after the initial read and after each
+// read that adds records.
+//
+// Returns false if the file can't be opened or watched.
+template <typename OnUpdate>
+bool followFile(const std::string &path, int N, OnUpdate on_update) {
+    FollowState state;
+    if (!followOpen(path, N, state)) {
+        std::cerr << "Could not open " << path << "\n";
+        return false;
+    }
+
+    int inotify_fd = inotify_init1(IN_CLOEXEC);
+    if (inotify_fd == -1
+            || inotify_add_watch(inotify_fd, path.c_str(),
+                                    IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF) == -1) {
+        std::cerr << "Could not watch " << path << ": " << strerror(errno) << "\n";
+        if (inotify_fd != -1) {
+            close(inotify_fd);
+        }
+        followClose(state);
+        return false;
+    }
+
+    // The handler's writes must never block, and the pipe is read to know
+    // it has run.
+    int wake_fds[2];
+    if (pipe(wake_fds) == -1) {
+        std::cerr << "Could not create the wakeup pipe: " << strerror(errno) << "\n";
+        close(inotify_fd);
+        followClose(state);
+        return false;
+    }
+    fcntl(wake_fds[1], F_SETFL, O_NONBLOCK);
+    follow_wake_fd = wake_fds[1];
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopFollowing;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    // The watch is added before the first read, so nothing appended in
+    // between can be missed.
+    bool ok = followRead(state) >= 0;
+    if (ok) {
+        on_update(state);
+    }
+
+    // Many writes can be reported by one read of the inotify fd, they are all
+    // handled with one followRead().
+    alignas(inotify_event) char events[4096];
+    pollfd waits[2] = {{inotify_fd, POLLIN, 0}, {wake_fds[0], POLLIN, 0}};
+
+    while (ok && !follow_stopping) {
+        // A signal after the check above still wakes this through the pipe.
+        if (poll(waits, 2, -1) == -1 || (waits[1].revents & POLLIN)
+                || !(waits[0].revents & POLLIN)) {
+            continue;
+        }
+
+        ssize_t n = read(inotify_fd, events, sizeof(events));
+        if (n <= 0) {
+            continue;
+        }
+
+        // Our open fd keeps a deleted file's inode alive, so IN_DELETE_SELF
+        // wouldn't arrive. Deleting it changes its link count though, which
+        // is reported as IN_ATTRIB.
+        bool gone = false;
+        for (char *event = events; event < events + n;) {
+            const inotify_event *header = reinterpret_cast<const inotify_event *>(event);
+            if (header->mask & (IN_MOVE_SELF | IN_IGNORED)) {
+                gone = true;
+            }
+            event += sizeof(inotify_event) + header->len;
+        }
+
+        struct stat file_stat;
+        if (fstat(state.fd, &file_stat) == 0 && file_stat.st_nlink == 0) {
+            gone = true;
+        }
+
+        long added = followRead(state);
+        if (added < 0) {
+            ok = false;
+        }
+        else if (added > 0) {
+            on_update(state);
+        }
+
+        if (gone) {
+            std::cerr << path << " was deleted or moved, stopping\n";
+            break;
+        }
+    }
+
+    follow_wake_fd = -1;
+    close(wake_fds[0]);
+    close(wake_fds[1]);
+
+    close(inotify_fd);
+    followClose(state);
+    return ok;
+}
+
+#endif
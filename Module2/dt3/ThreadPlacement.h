@@ -0,0 +1,98 @@
+// ----------------------------------------------------------------------------
+// File:        ThreadPlacement.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Choosing how many of the threads produce and how many consume,
+//              and which core each one runs on.
+//
+//              The auto split gives each stage threads in proportion to how
+//              long it takes per record, so if parsing a line costs three
+//              times what storing it does, three quarters of the threads
+//              parse. Pinning stops the scheduler moving threads between
+//              cores (and leaving their cache behind) mid run.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef THREAD_PLACEMENT_H
+#define THREAD_PLACEMENT_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+
+// Reads a comma separated list of core numbers, like "0,2,4,6".
+//
+// Returns false if any of them isn't a core number a cpu_set_t can hold.
+inline bool parseCoreList(const std::string &text, std::vector<int> &cores) {
+    cores.clear();
+
+    size_t begin = 0;
+    while (begin <= text.size()) {
+        size_t comma = std::min(text.find(',', begin), text.size());
+        std::string core = text.substr(begin, comma - begin);
+
+        if (core.empty() || core.find_first_not_of("0123456789") != std::string::npos
+                || core.size() > 4 || atoi(core.c_str()) >= CPU_SETSIZE) {
+            return false;
+        }
+        cores.push_back(atoi(core.c_str()));
+        begin = comma + 1;
+    }
+
+    return !cores.empty();
+}
+
+// The core for thread i (producers first, then consumers), going round the
+// list again if there are more threads than cores. -1 if not pinning.
+inline int threadCore(const std::vector<int> &cores, int i) {
+    return cores.empty() ? -1 : cores[i % cores.size()];
+}
+
+// pthread_create(), with the thread pinned to core unless it is -1.
+//
+// If the core can't be used (it is offline or outside the process's
+// affinity) the thread is created unpinned after a warning.
+inline void createPinnedThread(pthread_t *tid, void *(*fn)(void *), void *arg, int core) {
+    if (core >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(core, &cpus);
+
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        int result = pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+        if (result == 0) {
+            result = pthread_create(tid, &attr, fn, arg);
+        }
+        pthread_attr_destroy(&attr);
+
+        if (result == 0) {
+            return;
+        }
+        std::cerr << "Could not pin a thread to core " << core << ", leaving it unpinned\n";
+    }
+
+    pthread_create(tid, nullptr, fn, arg);
+}
+
+// Splits threads between producers and consumers in proportion to the time
+// each stage takes per record, leaving at least one of each.
+inline void balanceThreads(double produce_ns, double consume_ns, int threads,
+                            int &producers, int &consumers) {
+    double total_ns = produce_ns + consume_ns;
+    double share = (total_ns > 0) ? produce_ns / total_ns : 0.5;
+
+    producers = static_cast<int>(std::lround(threads * share));
+    producers = std::max(1, std::min(producers, threads - 1));
+    consumers = std::max(1, threads - producers);
+}
+
+#endif
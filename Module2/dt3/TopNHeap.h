@@ -0,0 +1,114 @@
+// ----------------------------------------------------------------------------
+// File:        TopNHeap.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              Streaming top N tracking, so the most congested lights can be
+//              found without keeping every record in memory.
+//
+//              Each consumer keeps a min-heap of at most N records for every
+//              hour. The heap's root is the least congested record still in
+//              the running, so a new record only has to beat it to get in.
+//              At the end the consumers' heaps are merged, which leaves the
+//              top N of every hour using O(threads x 24 x N) memory however
+//              big the data file is.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef TOP_N_HEAP_H
+#define TOP_N_HEAP_H
+
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+#include "TrafficData.h"
+
+// One thread's top N records for each hour, each kept as a min-heap on cars.
+struct TopNHeaps {
+    int N;
+    std::vector<TrafficLightRecord> hours[HOURS_PER_DAY];
+};
+
+// Heap comparer, the std heap functions keep the "largest" element at the
+// root so ordering by more cars gives a min-heap.
+inline bool compRecordMinHeap(const TrafficLightRecord &r_a, const TrafficLightRecord &r_b) {
+    return compRecord(r_b, r_a);
+}
+
+inline void initTopNHeaps(TopNHeaps &heaps, int N) {
+    heaps.N = N;
+    for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+        heaps.hours[hr].clear();
+        heaps.hours[hr].reserve(N);
+    }
+}
+
+// Offers a record to the heap for its hour. It is kept if there are fewer
+// than N records for that hour or it ranks above the least congested
+// one, which is then dropped.
+//
+// Returns false (and ignores the record) if its time isn't a time of day.
+inline bool addToTopN(TopNHeaps &heaps, const TrafficLightRecord &record) {
+    int hr = recordHour(record);
+    if (hr == -1) {
+        return false;
+    }
+
+    std::vector<TrafficLightRecord> &heap = heaps.hours[hr];
+
+    if (heap.size() < static_cast<size_t>(heaps.N)) {
+        heap.push_back(record);
+        push_heap(heap.begin(), heap.end(), compRecordMinHeap);
+    }
+    else if (heaps.N > 0 && compRecord(heap.front(), record)) {
+        pop_heap(heap.begin(), heap.end(), compRecordMinHeap);
+        heap.back() = record;
+        push_heap(heap.begin(), heap.end(), compRecordMinHeap);
+    }
+
+    return true;
+}
+
+// Merges num_heaps threads' heaps into result, which is initialised with the
+// same N.
+inline void mergeTopNHeaps(const TopNHeaps *heaps, int num_heaps, TopNHeaps &result) {
+    initTopNHeaps(result, (num_heaps > 0) ? heaps[0].N : 0);
+
+    for (int i = 0; i < num_heaps; i++) {
+        for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+            const std::vector<TrafficLightRecord> &heap = heaps[i].hours[hr];
+            for (size_t j = 0; j < heap.size(); j++) {
+                addToTopN(result, heap[j]);
+            }
+        }
+    }
+}
+
+// mostCongestion() for streamed data, the same result from only the records
+// that made it into hour hr's heap.
+//
+// Returns fewer than N records if the hour had fewer than N.
+//
+// @param N how many of the most congested lights you want data on, no more
+//          than the heaps were built with.
+// @param hr the hour of the day that you care about.
+inline std::vector<TrafficLightRecord> mostCongestion(const TopNHeaps &heaps, int hr, int N) {
+    std::vector<TrafficLightRecord> congested_lights;
+    if (hr < 0 || hr >= HOURS_PER_DAY) {
+        return congested_lights;
+    }
+
+    congested_lights = heaps.hours[hr];
+    sort(congested_lights.begin(), congested_lights.end(), compRecord);
+
+    if (congested_lights.size() > static_cast<size_t>(N)) {
+        congested_lights.erase(congested_lights.begin(), congested_lights.end() - N);
+    }
+
+    return congested_lights;
+}
+
+#endif
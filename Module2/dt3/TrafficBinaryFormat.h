@@ -0,0 +1,162 @@
+// ----------------------------------------------------------------------------
+// File:        TrafficBinaryFormat.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              A compact binary, column oriented, on-disk format for traffic
+//              light records, so a day's data can be loaded with one mmap
+//              instead of re-parsing the text data file every run.
+//
+//              Layout (all integers are native byte order, little endian on
+//              the machines we use):
+//
+//                  header      TrafficBinaryHeader (padded to 256 bytes)
+//                  time        int32 x num_records
+//                  id          int32 x num_records
+//                  cars        int32 x num_records
+//
+//              Records are grouped by hour, in the order they appeared in the
+//              text file within each hour, and the header's hour_offsets
+//              table gives the first record of each hour. So the records for
+//              hour h are [hour_offsets[h], hour_offsets[h + 1]) of each
+//              column.
+//
+// ----------------------------------------------------------------------------
+
+#ifndef TRAFFIC_BINARY_FORMAT_H
+#define TRAFFIC_BINARY_FORMAT_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "TrafficData.h"
+#include "MappedFile.h"
+
+const char TRAFFIC_BINARY_MAGIC[8] = {'T', 'R', 'A', 'F', 'C', 'O', 'L', '1'};
+const uint32_t TRAFFIC_BINARY_VERSION = 1;
+const size_t TRAFFIC_BINARY_HEADER_SIZE = 256;
+
+struct TrafficBinaryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t num_records;
+
+    // Record index where each hour starts, hour_offsets[24] is num_records.
+    uint64_t hour_offsets[HOURS_PER_DAY + 1];
+
+    // Byte offsets of each column from the start of the file.
+    uint64_t time_column;
+    uint64_t id_column;
+    uint64_t cars_column;
+};
+
+// A loaded binary data file. The columns point into the mapping.
+struct BinaryTrafficData {
+    MappedFile file;
+    const TrafficBinaryHeader *header;
+    const int32_t *time;
+    const int32_t *id;
+    const int32_t *cars;
+};
+
+// Fills in a header for records (which must already be grouped by hour)
+// given how many records each hour has.
+inline TrafficBinaryHeader makeBinaryHeader(const uint64_t hour_counts[HOURS_PER_DAY]) {
+    TrafficBinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRAFFIC_BINARY_MAGIC, sizeof(header.magic));
+    header.version = TRAFFIC_BINARY_VERSION;
+
+    for (int hr = 0; hr < HOURS_PER_DAY; hr++) {
+        header.hour_offsets[hr + 1] = header.hour_offsets[hr] + hour_counts[hr];
+    }
+    header.num_records = header.hour_offsets[HOURS_PER_DAY];
+
+    header.time_column = TRAFFIC_BINARY_HEADER_SIZE;
+    header.id_column = header.time_column + header.num_records * sizeof(int32_t);
+    header.cars_column = header.id_column + header.num_records * sizeof(int32_t);
+
+    return header;
+}
+
+// Returns true if a column of num_records int32s at byte offset is after the
+// header, 4 byte aligned and inside a file of file_size bytes. Nothing is
+// multiplied or added before it is known not to overflow.
+inline bool binaryColumnFits(uint64_t offset, uint64_t num_records, uint64_t file_size) {
+    return offset >= TRAFFIC_BINARY_HEADER_SIZE && offset <= file_size
+            && offset % sizeof(int32_t) == 0
+            && num_records <= (file_size - offset) / sizeof(int32_t);
+}
+
+// Maps a binary data file and checks that its header makes sense.
+//
+// Returns false if the file can't be mapped or isn't in the binary format.
+inline bool loadBinaryData(const char *path, BinaryTrafficData &data) {
+    if (!mapFile(path, data.file)) {
+        return false;
+    }
+
+    const TrafficBinaryHeader *header =
+        reinterpret_cast<const TrafficBinaryHeader *>(data.file.data);
+
+    bool valid = data.file.size >= TRAFFIC_BINARY_HEADER_SIZE
+                    && memcmp(header->magic, TRAFFIC_BINARY_MAGIC, 8) == 0
+                    && header->version == TRAFFIC_BINARY_VERSION
+                    && header->hour_offsets[HOURS_PER_DAY] == header->num_records
+                    && binaryColumnFits(header->time_column, header->num_records,
+                                        data.file.size)
+                    && binaryColumnFits(header->id_column, header->num_records,
+                                        data.file.size)
+                    && binaryColumnFits(header->cars_column, header->num_records,
+                                        data.file.size);
+
+    for (int hr = 0; valid && hr < HOURS_PER_DAY; hr++) {
+        valid = header->hour_offsets[hr] <= header->hour_offsets[hr + 1];
+    }
+
+    if (!valid) {
+        unmapFile(data.file);
+        return false;
+    }
+
+    // The columns are read in whole hours at random, not front to back.
+    madvise(const_cast<char *>(data.file.data), data.file.size, MADV_RANDOM);
+
+    data.header = header;
+    data.time = reinterpret_cast<const int32_t *>(data.file.data + header->time_column);
+    data.id = reinterpret_cast<const int32_t *>(data.file.data + header->id_column);
+    data.cars = reinterpret_cast<const int32_t *>(data.file.data + header->cars_column);
+    return true;
+}
+
+inline void unloadBinaryData(BinaryTrafficData &data) {
+    unmapFile(data.file);
+    data.header = nullptr;
+}
+
+// Returns the records for hour hr. Only that hour's part of each column is
+// touched.
+inline std::vector<TrafficLightRecord> binaryHourRecords(const BinaryTrafficData &data,
+                                                            int hr) {
+    std::vector<TrafficLightRecord> records;
+    if (hr < 0 || hr >= HOURS_PER_DAY) {
+        return records;
+    }
+
+    uint64_t begin = data.header->hour_offsets[hr];
+    uint64_t end = data.header->hour_offsets[hr + 1];
+    records.resize(end - begin);
+
+    for (uint64_t i = begin; i < end; i++) {
+        TrafficLightRecord record = {data.time[i], data.id[i], data.cars[i]};
+        records[i - begin] = record;
+    }
+
+    return records;
+}
+
+#endif
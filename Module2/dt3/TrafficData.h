@@ -0,0 +1,254 @@
+// ----------------------------------------------------------------------------
+// File:        TrafficData.h
+// Author:      Codey Funston
+// Version:     1.0.0
+//
+// Description:
+//
+//              The traffic light record and the functions for reading,
+//              ranking and printing them that are shared by the sequential
+//              and pthread simulators (and their benchmarks).
+//
+// ----------------------------------------------------------------------------
+
+#ifndef TRAFFIC_DATA_H
+#define TRAFFIC_DATA_H
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+
+#include "BulkWriter.h"
+
+struct TrafficLightRecord {
+    // Even though 24 hr times do not behave like usual base 10 numbers, they
+    // are still comparable and each consecutive minute is represented by a
+    // larger integer.
+
+    int time;
+    int id;
+    int cars;
+};
+
+const int HOURS_PER_DAY = 24;
+
+// Returns the hour of a record, or -1 if the time isn't in [0000, 2400).
+inline int recordHour(const TrafficLightRecord &record) {
+    int hr = record.time / 100;
+    return (record.time >= 0 && hr < HOURS_PER_DAY) ? hr : -1;
+}
+
+// A light's total cars over some period (an hour or a range of the day).
+struct LightTotal {
+    int id;
+    long long cars;
+};
+
+// Comparer for use in sorting congested traffic lights.
+//
+// Ties in cars are broken by id then time, so every way of ranking (sorting,
+// selection, heaps, in parallel or not) gives exactly the same order.
+inline bool compRecord(const TrafficLightRecord r_a, const TrafficLightRecord r_b) {
+    if (r_a.cars != r_b.cars) {
+        return (r_a.cars < r_b.cars);
+    }
+    if (r_a.id != r_b.id) {
+        return (r_a.id < r_b.id);
+    }
+    return (r_a.time < r_b.time);
+}
+
+// Returns a single entry from the data file.
+//
+// Or
+//
+// Returns an empty string ("") if at EOF.
+inline std::string readDataFromFile(std::ifstream &file) {
+    // By passing the file stream object in the file can be opened just once
+    // in main().
+
+    std::string line;
+
+    if (getline(file, line)) {
+        return line;
+    }
+    else {
+        return "";
+    }
+}
+
+// Takes a data file entry as a string and converts it to the traffic light
+// struct.
+inline TrafficLightRecord stringToRecord(std::string in_string) {
+    TrafficLightRecord record;
+    std::istringstream data_string_stream(in_string);
+
+    // By using a string stream we can take each word from the string without
+    // having to do manual checking for spaces by moving through character by
+    // character.
+
+    data_string_stream >> record.time;
+    data_string_stream >> record.id;
+    data_string_stream >> record.cars;
+
+    return record;
+}
+
+// Returns the N records of subset with the most cars, in increasing order of
+// cars. Fewer than N are returned if there aren't that many. subset is
+// reordered.
+inline std::vector<TrafficLightRecord> topNRecords(std::vector<TrafficLightRecord> &subset,
+                                                    int N) {
+    N = std::max(0, std::min(N, static_cast<int>(subset.size())));
+    std::vector<TrafficLightRecord> N_most_congested_lights(N);
+
+    // Doing an nth_element sort is more efficient for our requirements since
+    // it puts all the elements that are greater than the element at index n
+    // in a sorted version of the vector. So we end up with all the elements
+    // we want to the right (unsorted, they are sorted separately below).
+    //
+    // It runs in O(n) time as opposed to O(nlogn) time for a whole sort.
+    nth_element(subset.begin(), subset.end() - N, subset.end(), compRecord);
+
+    for (size_t i = subset.size() - N, j = 0; j < static_cast<size_t>(N); i++, j++) {
+        N_most_congested_lights[j] = subset[i];
+    }
+
+    sort(N_most_congested_lights.begin(), N_most_congested_lights.end(), compRecord);
+
+    return N_most_congested_lights;
+}
+
+// Comparer for use in sorting light totals.
+//
+// Ties in cars are broken by id, as in compRecord(), so every ranking of
+// totals gives the same order.
+inline bool compLightTotal(const LightTotal t_a, const LightTotal t_b) {
+    if (t_a.cars != t_b.cars) {
+        return (t_a.cars < t_b.cars);
+    }
+    return (t_a.id < t_b.id);
+}
+
+// topNRecords() for light totals, in increasing order of cars. Fewer than N
+// are returned if there aren't that many. totals is reordered.
+inline std::vector<LightTotal> topNLightTotals(std::vector<LightTotal> &totals, int N) {
+    N = std::max(0, std::min(N, static_cast<int>(totals.size())));
+    if (totals.size() > static_cast<size_t>(N)) {
+        nth_element(totals.begin(), totals.end() - N, totals.end(), compLightTotal);
+        totals.erase(totals.begin(), totals.end() - N);
+    }
+    sort(totals.begin(), totals.end(), compLightTotal);
+
+    return totals;
+}
+
+// Returns a vector of traffic light records with the most congestion.
+//
+// @param N how many of the most congested lights you want data on.
+// @param hr the hour of the day that you care about.
+inline std::vector<TrafficLightRecord> mostCongestion(
+        std::vector<TrafficLightRecord> &records, int hr_start, int N) {
+    std::vector<TrafficLightRecord> subset;
+
+    for (size_t i = 0; i < records.size(); i++) {
+        int hr_val = records[i].time / 100;
+        if (hr_val >= hr_start && hr_val < hr_start + 1) {
+            subset.push_back(records[i]);
+        }
+    }
+
+    return topNRecords(subset, N);
+}
+
+// Returns formatted string representation of a traffic light record.
+inline std::string visualRecord(TrafficLightRecord record) {
+    std::string id, time, cars;
+
+    id =   "\tID: " + std::to_string(record.id);
+    time = "\n\tTime: " + std::to_string(record.time);
+    cars = "\n\tCars Passed: " + std::to_string(record.cars);
+
+    return id + time + cars;
+}
+
+// Writes the result of mostCongestion(), most congested first, in format:
+// "human" (the visualRecord() listing), "csv" (with a header line) or
+// "jsonl" (one JSON object a line).
+inline void writeMostCongested(BulkWriter &writer,
+                                const std::vector<TrafficLightRecord> &congested_lights, int N,
+                                const std::string &format) {
+    if (format == "csv") {
+        appendText(writer, "rank,id,time,cars\n");
+    }
+
+    // Ranks count from however many there are, which can be fewer than N.
+    N = std::min(N, static_cast<int>(congested_lights.size()));
+
+    for (int i = congested_lights.size() - 1; i >= 0; i--) {
+        const TrafficLightRecord &record = congested_lights[i];
+
+        if (format == "csv") {
+            appendInt(writer, N - i);
+            appendText(writer, ",");
+            appendInt(writer, record.id);
+            appendText(writer, ",");
+            appendInt(writer, record.time);
+            appendText(writer, ",");
+            appendInt(writer, record.cars);
+            appendText(writer, "\n");
+        }
+        else if (format == "jsonl") {
+            appendText(writer, "{\"rank\": ");
+            appendInt(writer, N - i);
+            appendText(writer, ", \"id\": ");
+            appendInt(writer, record.id);
+            appendText(writer, ", \"time\": ");
+            appendInt(writer, record.time);
+            appendText(writer, ", \"cars\": ");
+            appendInt(writer, record.cars);
+            appendText(writer, "}\n");
+        }
+        else {
+            appendText(writer, "(");
+            appendInt(writer, N - i);
+            appendText(writer, ")\n\tID: ");
+            appendInt(writer, record.id);
+            appendText(writer, "\n\tTime: ");
+            appendInt(writer, record.time);
+            appendText(writer, "\n\tCars Passed: ");
+            appendInt(writer, record.cars);
+            appendText(writer, "\n\n");
+        }
+    }
+}
+
+// Prints the result of mostCongestion(), most congested first, to stdout
+// with a BulkWriter (see writeMostCongested() for the formats).
+inline void printMostCongested(const std::vector<TrafficLightRecord> &congested_lights,
+                                int N, const std::string &format = "human") {
+    // Anything already printed through cout has to come out first.
+    std::cout << std::flush;
+
+    // A small result doesn't need the whole buffer.
+    BulkWriter writer;
+    initBulkWriter(writer, STDOUT_FILENO, std::min<size_t>(BULK_WRITER_SIZE,
+                                                            congested_lights.size() * 64 + 64));
+    writeMostCongested(writer, congested_lights, N, format);
+    flushBulkWriter(writer);
+}
+
+// Prints a ranking of light totals, most congested first.
+inline void printLightTotals(const std::vector<LightTotal> &congested_lights) {
+    for (int i = congested_lights.size() - 1; i >= 0; i--) {
+        std::cout << "(" + std::to_string(congested_lights.size() - i) + ")\n"
+            << "\tID: " << congested_lights[i].id
+            << "\n\tCars Passed: " << congested_lights[i].cars << "\n\n";
+    }
+}
+
+#endif
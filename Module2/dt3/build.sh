@@ -0,0 +1,21 @@
+#!/bin/bash
+
+# Compiles the simulators and their tools into the current directory.
+DIR=$(dirname "$0")
+FLAGS="-std=c++11 -O2"
+
+g++ $FLAGS "$DIR/SEQ_TrafficControlSimulator.cpp" -o sequential -lpthread
+g++ $FLAGS "$DIR/pthread_TrafficControlSimulator.cpp" -o threaded -lpthread
+g++ $FLAGS "$DIR/IngestBenchmark.cpp" -o ingest_benchmark
+g++ $FLAGS "$DIR/ParserBenchmark.cpp" -o parser_benchmark
+g++ $FLAGS "$DIR/QueueBenchmark.cpp" -o queue_benchmark -lpthread
+g++ $FLAGS "$DIR/ConvertData.cpp" -o convert_data
+g++ $FLAGS "$DIR/QueryClient.cpp" -o query_client -lpthread
+g++ $FLAGS "$DIR/AggregateBenchmark.cpp" -o aggregate_benchmark -lpthread
+g++ $FLAGS "$DIR/RecordBenchmark.cpp" -o record_benchmark -lpthread
+g++ $FLAGS "$DIR/SelectBenchmark.cpp" -o select_benchmark -lpthread
+g++ $FLAGS "$DIR/FilterBenchmark.cpp" -o filter_benchmark
+g++ $FLAGS "$DIR/GenerateData.cpp" -o generate_data -lpthread
+g++ $FLAGS "$DIR/BenchmarkDriver.cpp" -o benchmark_driver
+g++ $FLAGS "$DIR/OutputBenchmark.cpp" -o output_benchmark
+g++ $FLAGS "$DIR/SketchBenchmark.cpp" -o sketch_benchmark -lpthread
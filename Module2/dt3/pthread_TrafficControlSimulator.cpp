@@ -20,6 +20,28 @@
 #include <sstream>
 #include <queue>
 #include <algorithm>
+#include <atomic>
+#include <iomanip>
+
+#include "TrafficData.h"
+#include "MappedFile.h"
+#include "TrafficBinaryFormat.h"
+#include "RingBuffer.h"
+#include "HourIndex.h"
+#include "TopNHeap.h"
+#include "BatchQuery.h"
+#include "QueryServer.h"
+#include "TailFollow.h"
+#include "RangeSums.h"
+#include "HashAggregate.h"
+#include "PackedRecord.h"
+#include "RecordColumns.h"
+#include "RunStats.h"
+#include "ThreadPlacement.h"
+#include "SpillPartitions.h"
+#include "PipelineCounters.h"
+#include "EventCount.h"
+#include "HeavyHitters.h"
 
 using namespace std::chrono;
 using namespace std;
@@ -28,6 +50,9 @@ const long NUM_CORES = sysconf(_SC_NPROCESSORS_ONLN);
 const int NUM_THREADS = NUM_CORES;
 const int BUFF_SIZE = 100;
 
+// Records parsed and stored to time each stage for --producers=auto.
+const int WARMUP_RECORDS = 1 << 16;
+
 // The number of entries in the data file will be 96 * NUM_TRAFFIC_LIGHTS.
 // This is why "cars" values are allowed to be up to 100,000. Otherwise
 // the top N most congested traffic lights usually have the same number
@@ -35,73 +60,290 @@ const int BUFF_SIZE = 100;
 
 const int NUM_TRAFFIC_LIGHTS = 1000;
 
-struct TrafficLightRecord {
-    // Even though 24 hr times do not behave like usual base 10 numbers, they
-    // are still comparable and each consecutive minute is represented by a
-    // larger integer.
+// Options given after N and hr on the command line, for example:
+//
+//      ./threaded 5 8 --input=mmap --data=./big_data
+//
+// hr can also be a range of the day, to rank lights by their total cars over
+// it (see RangeSums.h):
+//
+//      ./threaded 5 0745-0915
+//
+// In batch and server mode there is no N and hr, just the options:
+//
+//      ./threaded --batch=queries.txt --input=partitioned
+//      ./threaded --serve=/tmp/traffic.sock --input=binary --data=data.bin
+struct SimulatorOptions {
+    string input = "getline";   // "getline", "mmap", "partitioned" or "binary".
+    string data_path = "./data";
+    string channel = "queue";   // "queue" (mutex + condvars) or "ring".
+    int ring_size = BUFF_SIZE;
+
+    // "index" keeps every record in an HourIndex, "streaming" only keeps
+    // each hour's top N (see TopNHeap.h), "columns" keeps every record
+    // in RecordColumns, filtered with SIMD at query time, and "spill"
+    // writes every record to per-hour files in a directory of its own made
+    // inside spill_dir (and removed after the query), using no more than
+    // memory_budget_mb of buffers (see SpillPartitions.h), and
+    // "sketch" only keeps approximate light totals per hour, within
+    // sketch_error of the hour's cars (see HeavyHitters.h).
+    string store = "index";
+    string spill_dir = ".";
+    int memory_budget_mb = 256;
+    double sketch_error = DEFAULT_SKETCH_ERROR;
+
+    // A file of "N hr" queries to answer instead of the one on the command
+    // line, "-" reads them from stdin.
+    string batch_path;
+
+    // Serve queries on a Unix socket at this path instead of answering one
+    // and exiting (see QueryServer.h).
+    string socket_path;
+
+    // Keep following the data file as it is appended to, printing the new
+    // ranking after each update (see TailFollow.h).
+    bool follow = false;
+
+    // For a range query (hr given as HHMM-HHMM), print this light's total
+    // instead of a ranking. -1 for none, ids are never negative.
+    int light = -1;
+
+    // Rank lights by their total cars in the hour instead of by single
+    // records (see HashAggregate.h).
+    bool aggregate = false;
+
+    // "full" moves and stores 12 byte TrafficLightRecords, "packed" 8 byte
+    // PackedRecords (see PackedRecord.h).
+    string record = "full";
+
+    // Threads used for ingesting and querying, and the producer/consumer
+    // split of them. Producers and consumers default to half of threads
+    // each (see resolveThreads()).
+    int threads = NUM_THREADS;
+    int producers = 0;
+    int consumers = 0;
+
+    // Split threads by timing both stages on the start of the data file
+    // first (see warmupSplit()), rather than half each.
+    bool auto_split = false;
+
+    // Cores to pin the threads to, producers first, going round again if
+    // there are more threads (see ThreadPlacement.h). Empty leaves them to
+    // the scheduler.
+    vector<int> pin_cores;
+
+    // Records the queue channel holds before producers wait.
+    int buffer_size = BUFF_SIZE;
 
-    int time;
-    int id;
-    int cars;
+    // How the queue channel wakes waiting threads, "targeted" wakes only as
+    // many as have work, in batches at watermarks (see EventCount.h), and
+    // "broadcast" wakes every waiter on every push and pop.
+    string wakeup = "targeted";
+
+    // How a single hour query's ranking is printed: "human", "csv" or
+    // "jsonl" (see writeMostCongested() in TrafficData.h).
+    string format = "human";
+
+    // Print the run's timing as JSON on stderr (see RunStats.h).
+    bool stats = false;
+
+#ifndef NO_PIPELINE_COUNTERS
+    // Print each thread's contention counters on stderr after ingesting, as
+    // a table and as JSON (see PipelineCounters.h).
+    bool counters = false;
+#endif
 };
 
 // Data for producer threads.
+//
+// signals is set for targeted wakeups, otherwise the condition variables
+// are broadcast.
+//
+// In mmap input mode cursor points to the shared position in the mapped
+// file, otherwise it is null and data_file is read with getline.
+//
+// In partitioned input mode each producer has its own byte range of the
+// mapped file, cursor points to range_cursor and own_range is set so the
+// file is read without holding the mutex.
+//
+// Records are parsed as TrafficLightRecords, then converted to Record for
+// the channel. unpackable counts the ones that can't be.
+template <typename Record>
 struct Prod_ThreadData {
     pthread_mutex_t *mutex;
     pthread_cond_t *buff_has_space;
     pthread_cond_t *buff_has_task;
+    QueueSignals *signals;
     ifstream *data_file;
-    queue<TrafficLightRecord> *buffer;
+    const char **cursor;
+    const char *end;
+    const char *range_cursor;
+    bool own_range;
+    queue<Record> *buffer;
+    size_t buffer_size;
+    RingBuffer<Record> *ring;
+    atomic<int> *producers_left;
+    int num_consumers;
+    atomic<long> *unpackable;
+    atomic<long long> *lock_wait_ns;
+#ifndef NO_PIPELINE_COUNTERS
+    ThreadCounters counters;
+#endif
 };
 
 // Data for consumer threads.
+//
+// Each consumer sorts the records it takes into its own per-hour buckets,
+// so the only thing done while holding the mutex is the dequeue. They are
+// built into an HourIndex after the threads are joined.
+//
+// In streaming mode heaps is set instead of buckets and the consumer only
+// keeps its top N records per hour, in columns mode columns is set and the
+// consumer appends to it, in spill mode spill is set and the consumer
+// writes to its own partition files, and in sketch mode sketches is set and
+// the consumer counts its light totals in them (full records only for the
+// last three).
+template <typename Record>
 struct Cons_ThreadData {
     pthread_mutex_t *mutex;
     pthread_cond_t *buff_has_task;
     pthread_cond_t *buff_has_space;
-    queue<TrafficLightRecord> *buffer;
-    vector<TrafficLightRecord> *records;
+    QueueSignals *signals;
+    queue<Record> *buffer;
+    size_t buffer_size;
+    RingBuffer<Record> *ring;
+    HourBucketsOf<Record> *buckets;
+    TopNHeaps *heaps;
+    RecordColumns *columns;
+    SpillPartitions *spill;
+    HeavyHitterSketches *sketches;
+    atomic<long long> *lock_wait_ns;
+    long long records;
+#ifndef NO_PIPELINE_COUNTERS
+    ThreadCounters counters;
+#endif
 };
 
-// Comparer for use in sorting congested traffic lights.
-bool compRecord(const TrafficLightRecord r_a, const TrafficLightRecord r_b) {
-    return (r_a.cars < r_b.cars);
+// Reads the next record for a producer from whichever input is in use.
+//
+// Returns false at EOF (or the end of the producer's range).
+//
+// *Note: The mutex must be held by the caller, unless the producer has its
+// own range.
+template <typename Record>
+bool readRecord(Prod_ThreadData<Record> *data, TrafficLightRecord &record) {
+    if (data->cursor != nullptr) {
+        return nextMappedRecord(*data->cursor, data->end, record);
+    }
+
+    string str_record = readDataFromFile(*data->data_file);
+    if (str_record.empty()) {
+        return false;
+    }
+
+    record = stringToRecord(str_record);
+    return true;
 }
 
-// Returns a single entry from the data file.
-// 
-// Or
+// Converts a parsed record to the type that goes through the channel.
 //
-// Returns an empty string ("") if at EOF.
-string readDataFromFile(ifstream &file) {
-    // By passing the file stream object in the file can be opened just once
-    // in main().
+// Returns false if it can't be.
+bool convertRecord(const TrafficLightRecord &record, TrafficLightRecord &converted) {
+    converted = record;
+    return true;
+}
 
-    string line;
+bool convertRecord(const TrafficLightRecord &record, PackedRecord &converted) {
+    return packRecord(record, converted);
+}
 
-    if (getline(file, line)) {
-        return line;
-    }
-    else {
-        return "";
+// Reads the next record for a producer and converts it, skipping (and
+// counting) any that don't convert.
+//
+// Returns false at EOF (or the end of the producer's range).
+template <typename Record>
+bool nextRecord(Prod_ThreadData<Record> *data, Record &record) {
+    TrafficLightRecord parsed;
+    while (readRecord(data, parsed)) {
+        if (convertRecord(parsed, record)) {
+            return true;
+        }
+        data->unpackable->fetch_add(1);
     }
+    return false;
+}
+
+// The "silly" record that tells a consumer there is no data left.
+void sillyRecord(TrafficLightRecord &record) {
+    record.time = record.id = record.cars = -1;
+}
+
+void sillyRecord(PackedRecord &record) {
+    // Its minute of day is 2047, which no real record packs to.
+    record.bits = ~0ULL;
+}
+
+bool isSillyRecord(const TrafficLightRecord &record) {
+    return (record.time == -1);
 }
 
-// Takes a data file entry as a string and converts it to the traffic light
-// struct.
-TrafficLightRecord stringToRecord(string in_string) {
-    TrafficLightRecord record;
-    istringstream data_string_stream(in_string);
+bool isSillyRecord(const PackedRecord &record) {
+    return (record.bits == ~0ULL);
+}
 
-    // By using a string stream we can take each word from the string without
-    // having to do manual checking for spaces by moving through character by
-    // character.
+// Locks mutex, adding the time spent blocked on it to lock_wait_ns. The
+// clock is only read when the mutex is already held by another thread.
+//
+// Returns the time blocked in nanoseconds.
+long long lockTimed(pthread_mutex_t *mutex, atomic<long long> *lock_wait_ns) {
+    if (pthread_mutex_trylock(mutex) == 0) {
+        return 0;
+    }
 
-    data_string_stream >> record.time;
-    data_string_stream >> record.id;
-    data_string_stream >> record.cars;
+    auto start = high_resolution_clock::now();
+    pthread_mutex_lock(mutex);
+    long long waited = duration_cast<nanoseconds>(high_resolution_clock::now() - start).count();
+    lock_wait_ns->fetch_add(waited);
+    return waited;
+}
 
-    return record;
+// Keeps a record a consumer has taken in its buckets.
+template <typename Record>
+void storeRecord(Cons_ThreadData<Record> *data, const Record &record) {
+    addToBuckets(*data->buckets, record);
+}
+
+// Keeps a full record a consumer has taken, in whichever store is in use.
+void storeRecord(Cons_ThreadData<TrafficLightRecord> *data, const TrafficLightRecord &record) {
+    if (data->heaps != nullptr) {
+        addToTopN(*data->heaps, record);
+    }
+    else if (data->columns != nullptr) {
+        addToColumns(*data->columns, record);
+    }
+    else if (data->spill != nullptr) {
+        addToSpill(*data->spill, record);
+    }
+    else if (data->sketches != nullptr) {
+        addToHeavyHitters(*data->sketches, record);
+    }
+    else {
+        addToBuckets(*data->buckets, record);
+    }
+}
+
+// Releases the mutex until the queue may have changed, with whichever
+// wakeups are in use.
+//
+// *Note: The mutex must be held by the caller.
+void waitOn(QueueSignals *signals, EventCount QueueSignals::*event, pthread_cond_t *cond,
+                pthread_mutex_t *mutex) {
+    if (signals != nullptr) {
+        eventWait(signals->*event, mutex);
+    }
+    else {
+        pthread_cond_wait(cond, mutex);
+    }
 }
 
 // Worker function for producer threads.
@@ -110,39 +352,73 @@ TrafficLightRecord stringToRecord(string in_string) {
 // is space.
 //
 // *Note: The function is blocking to its thread while there is full.
+template <typename Record>
 void *produce(void *arg) {
-    Prod_ThreadData *data = static_cast<Prod_ThreadData *>(arg);
+    Prod_ThreadData<Record> *data = static_cast<Prod_ThreadData<Record> *>(arg);
 
-    string str_record;
+    Record record;
     while (true) {
-        pthread_mutex_lock(data->mutex);
+        // A producer with its own range parses before taking the lock, so
+        // only the queue push is serialized.
+        bool have_record = data->own_range && nextRecord(data, record);
+
+        PIPELINE_COUNT(data->counters.lock_ns +=) lockTimed(data->mutex, data->lock_wait_ns);
 
         // Checks to see if the buffer is full, and if it is, waits for 
         // a consumer to send an alert that it has space.
-        while (data->buffer->size() == BUFF_SIZE) {
-            pthread_cond_wait(data->buff_has_space, data->mutex);
+        while (data->buffer->size() >= data->buffer_size) {
+            PIPELINE_COUNT(auto wait_start = high_resolution_clock::now());
+            waitOn(data->signals, &QueueSignals::has_space, data->buff_has_space, data->mutex);
+            PIPELINE_COUNT(countWait(data->counters.wait_space_ns, wait_start);
+                            data->counters.waits++;
+                            data->counters.empty_wakeups += (data->buffer->size()
+                                                                >= data->buffer_size));
         }
 
-        str_record = readDataFromFile(*data->data_file);
+        if (!data->own_range) {
+            have_record = nextRecord(data, record);
+        }
 
         // When all data from the file has been read.
-        if (str_record.empty()) {
+        if (!have_record) {
             // A "silly" record is used to signal to all the consumers
-            // that there is no data left.
-            for (int i = 0; i < NUM_THREADS - (NUM_THREADS / 2); i++) {
-                TrafficLightRecord silly_record = {-1, -1, -1};
-                data->buffer->push(silly_record);
-                pthread_cond_broadcast(data->buff_has_task);
+            // that there is no data left. Only the last producer to finish
+            // sends them, since the others may still have records to push.
+            if (data->producers_left->fetch_sub(1) == 1) {
+                for (int i = 0; i < data->num_consumers; i++) {
+                    Record silly_record;
+                    sillyRecord(silly_record);
+                    data->buffer->push(silly_record);
+                }
+
+                // Every consumer has to see one, whatever the watermarks.
+                if (data->signals != nullptr) {
+                    eventNotify(data->signals->has_task, data->num_consumers);
+                }
+                else {
+                    pthread_cond_broadcast(data->buff_has_task);
+                }
+            }
+
+            // This producer may have been woken for a slot it won't use.
+            if (data->signals != nullptr) {
+                notifyProducerExit(*data->signals);
             }
 
             pthread_mutex_unlock(data->mutex);
             break;
         }
 
-        TrafficLightRecord record = stringToRecord(str_record);
         data->buffer->push(record);
+        PIPELINE_COUNT(data->counters.records++;
+                        countOccupancy(data->counters, data->buffer->size(), data->buffer_size));
 
-        pthread_cond_broadcast(data->buff_has_task);
+        if (data->signals != nullptr) {
+            notifyPushed(*data->signals, data->buffer->size());
+        }
+        else {
+            pthread_cond_broadcast(data->buff_has_task);
+        }
         pthread_mutex_unlock(data->mutex);
     }
 
@@ -151,28 +427,34 @@ void *produce(void *arg) {
 
 // Worker function for consumer threads.
 //
-// Consumer threads take data from the queue, then place it in a records
-// container.
+// Consumer threads take data from the queue, then place it in their own
+// bucket (or heap) for its hour.
 //
 // *Note: The function is blocking to its thread while the queue is empty.
+template <typename Record>
 void *consume(void *arg) {
-    Cons_ThreadData *data = static_cast<Cons_ThreadData *>(arg);
+    Cons_ThreadData<Record> *data = static_cast<Cons_ThreadData<Record> *>(arg);
 
     while (true) {
-        pthread_mutex_lock(data->mutex);
+        PIPELINE_COUNT(data->counters.lock_ns +=) lockTimed(data->mutex, data->lock_wait_ns);
 
         // Checks to see if the buffer has any tasks, if not, waits for a 
         // producer to send an alert that it has a task.
         while (data->buffer->empty()) {
-            pthread_cond_wait(data->buff_has_task, data->mutex);
+            PIPELINE_COUNT(auto wait_start = high_resolution_clock::now());
+            waitOn(data->signals, &QueueSignals::has_task, data->buff_has_task, data->mutex);
+            PIPELINE_COUNT(countWait(data->counters.wait_task_ns, wait_start);
+                            data->counters.waits++;
+                            data->counters.empty_wakeups += data->buffer->empty());
         }
 
-        TrafficLightRecord record = data->buffer->front();
+        Record record = data->buffer->front();
+        PIPELINE_COUNT(countOccupancy(data->counters, data->buffer->size(), data->buffer_size));
 
         // If a "silly" record is received the thread exits because all the
         // data from the file has been received and all tasks have been
         // assigned/completed.
-        if (record.time == -1) {
+        if (isSillyRecord(record)) {
             pthread_mutex_unlock(data->mutex);
             break;
         }
@@ -180,63 +462,360 @@ void *consume(void *arg) {
         // After calling front() on a queue it must be popped because pop()
         // doesn't return the value removed unlike most other languages.
         data->buffer->pop();
-        data->records->push_back(record);
 
-        pthread_cond_broadcast(data->buff_has_space);
+        if (data->signals != nullptr) {
+            notifyPopped(*data->signals, data->buffer->size(), data->buffer_size);
+        }
+        else {
+            pthread_cond_broadcast(data->buff_has_space);
+        }
         pthread_mutex_unlock(data->mutex);
+
+        storeRecord(data, record);
+        data->records++;
+        PIPELINE_COUNT(data->counters.records++);
     }
 
     pthread_exit(nullptr);
 }
 
-// Returns a vector of traffic light records with the most congestion.
+// Worker function for producer threads using the ring buffer channel.
 //
-// @param N how many of the most congested lights you want data on.
-// @param hr the hour of the day that you care about.
-vector<TrafficLightRecord> mostCongestion(vector<TrafficLightRecord> &records,
-                                            int hr_start, int N) {
-    vector<TrafficLightRecord> N_most_congested_lights(N);
-    vector<TrafficLightRecord> subset;
+// The mutex is only held while reading from a shared data file, records are
+// pushed to the ring without it.
+template <typename Record>
+void *produceRing(void *arg) {
+    Prod_ThreadData<Record> *data = static_cast<Prod_ThreadData<Record> *>(arg);
+
+    Record record;
+    while (true) {
+        bool have_record;
+        if (data->own_range) {
+            have_record = nextRecord(data, record);
+        }
+        else {
+            PIPELINE_COUNT(data->counters.lock_ns +=) lockTimed(data->mutex, data->lock_wait_ns);
+            have_record = nextRecord(data, record);
+            pthread_mutex_unlock(data->mutex);
+        }
+
+        if (!have_record) {
+            break;
+        }
 
-    for (int i = 0; i < records.size(); i++) {
-        int hr_val = records[i].time / 100;
-        if (hr_val >= hr_start && hr_val < hr_start + 1) {
-            subset.push_back(records[i]);
+        ringPush(*data->ring, record);
+        PIPELINE_COUNT(data->counters.records++);
+    }
+
+    // Only the last producer to finish sends the "silly" records, so every
+    // real record is already in the ring ahead of them and each consumer
+    // gets exactly one.
+    if (data->producers_left->fetch_sub(1) == 1) {
+        Record silly_record;
+        sillyRecord(silly_record);
+        for (int i = 0; i < data->num_consumers; i++) {
+            ringPush(*data->ring, silly_record);
         }
     }
 
-    // Doing an nth_element sort is more efficient for our requirements since
-    // it puts all the elements that are greater than the element at index n
-    // in a sorted version of the vector. So we end up with all the elements
-    // we want to the right (unsorted, they are sorted separately below).
-    //
-    // It runs in O(n) time as opposed to O(nlogn) time for a whole sort.
-    nth_element(subset.begin(), subset.end() - N, subset.end(), compRecord);
+    pthread_exit(nullptr);
+}
+
+// Worker function for consumer threads using the ring buffer channel.
+template <typename Record>
+void *consumeRing(void *arg) {
+    Cons_ThreadData<Record> *data = static_cast<Cons_ThreadData<Record> *>(arg);
+
+    Record record;
+    while (true) {
+        ringPop(*data->ring, record);
 
-    for (int i = subset.size() - N, j = 0; i < subset.size(), j < N; i++, j++) {
-        N_most_congested_lights[j] = subset[i];
+        if (isSillyRecord(record)) {
+            break;
+        }
+
+        storeRecord(data, record);
+        data->records++;
+        PIPELINE_COUNT(data->counters.records++);
     }
 
-    sort(N_most_congested_lights.begin(), N_most_congested_lights.end(), compRecord);
+    pthread_exit(nullptr);
+}
 
-    return N_most_congested_lights;
+// Reads the --name=value options from argv[first] on.
+//
+// Returns false (after printing why) if an option isn't recognised.
+bool parseOptions(int argc, char *argv[], int first, SimulatorOptions &options) {
+    for (int i = first; i < argc; i++) {
+        string arg = argv[i];
+        size_t equals = arg.find('=');
+        string name = arg.substr(0, equals);
+        string value = (equals == string::npos) ? "" : arg.substr(equals + 1);
+
+        if (name == "--input"
+                && (value == "getline" || value == "mmap" || value == "partitioned"
+                    || value == "binary")) {
+            options.input = value;
+        }
+        else if (name == "--data" && !value.empty()) {
+            options.data_path = value;
+        }
+        else if (name == "--channel" && (value == "queue" || value == "ring")) {
+            options.channel = value;
+        }
+        else if (name == "--ring-size" && atoi(value.c_str()) > 0) {
+            options.ring_size = atoi(value.c_str());
+        }
+        else if (name == "--store"
+                    && (value == "index" || value == "streaming" || value == "columns"
+                        || value == "spill" || value == "sketch")) {
+            options.store = value;
+        }
+        else if (name == "--sketch-error" && atof(value.c_str()) > 0
+                    && atof(value.c_str()) < 1) {
+            options.sketch_error = atof(value.c_str());
+        }
+        else if (name == "--spill-dir" && !value.empty()) {
+            options.spill_dir = value;
+        }
+        else if (name == "--memory-budget" && atoi(value.c_str()) > 0) {
+            options.memory_budget_mb = atoi(value.c_str());
+        }
+        else if (name == "--batch" && !value.empty()) {
+            options.batch_path = value;
+        }
+        else if (name == "--serve" && !value.empty()) {
+            options.socket_path = value;
+        }
+        else if (arg == "--follow") {
+            options.follow = true;
+        }
+        else if (arg == "--aggregate") {
+            options.aggregate = true;
+        }
+        else if (name == "--record" && (value == "full" || value == "packed")) {
+            options.record = value;
+        }
+        else if (name == "--threads" && atoi(value.c_str()) > 0) {
+            options.threads = atoi(value.c_str());
+        }
+        else if (arg == "--producers=auto") {
+            options.auto_split = true;
+        }
+        else if (name == "--producers" && atoi(value.c_str()) > 0) {
+            options.producers = atoi(value.c_str());
+        }
+        else if (name == "--consumers" && atoi(value.c_str()) > 0) {
+            options.consumers = atoi(value.c_str());
+        }
+        else if (name == "--buffer-size" && atoi(value.c_str()) > 0) {
+            options.buffer_size = atoi(value.c_str());
+        }
+        else if (name == "--wakeup" && (value == "targeted" || value == "broadcast")) {
+            options.wakeup = value;
+        }
+        else if (name == "--pin"
+                    && (value == "spread" || parseCoreList(value, options.pin_cores))) {
+            // "spread" is one thread per online core, in order.
+            for (int core = 0; value == "spread" && core < NUM_CORES; core++) {
+                options.pin_cores.push_back(core);
+            }
+        }
+        else if (name == "--format" && (value == "human" || value == "csv" || value == "jsonl")) {
+            options.format = value;
+        }
+        else if (arg == "--stats") {
+            options.stats = true;
+        }
+#ifndef NO_PIPELINE_COUNTERS
+        else if (arg == "--counters") {
+            options.counters = true;
+        }
+#endif
+        else if (name == "--light" && !value.empty()
+                    && value.find_first_not_of("0123456789") == string::npos) {
+            options.light = atoi(value.c_str());
+        }
+        else {
+            cerr << "Unknown option: " << arg << "\n";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Fills in the producer and consumer counts that weren't given. At least one
+// of each is needed or a single core machine would have no producers and
+// the consumers would wait forever.
+void resolveThreads(SimulatorOptions &options) {
+    if (options.producers == 0) {
+        options.producers = max(1, (options.consumers == 0) ? options.threads / 2
+                                                            : options.threads - options.consumers);
+    }
+    if (options.consumers == 0) {
+        options.consumers = max(1, options.threads - options.producers);
+    }
 }
 
-// Returns formatted string representation of a traffic light record.
-string visualRecord(TrafficLightRecord record) {
-    string id, time, cars;
+// Times parsing and storing the first WARMUP_RECORDS records of the data
+// file on this thread, then splits options.threads between producers and
+// consumers to match. The warmup reads through its own handle, so ingest
+// still starts from the top of the file.
+template <typename Record>
+void warmupSplit(SimulatorOptions &options, int N) {
+    ifstream data_file;
+    MappedFile mapped = {nullptr, 0, -1};
+    const char *cursor = nullptr;
+    atomic<long> unpackable(0);
 
-    id =   "\tID: " + to_string(record.id);
-    time = "\n\tTime: " + to_string(record.time);
-    cars = "\n\tCars Passed: " + to_string(record.cars);
+    bool use_mapping = (options.input == "mmap" || options.input == "partitioned");
+    if (use_mapping) {
+        if (!mapFile(options.data_path.c_str(), mapped)) {
+            return;
+        }
+        cursor = mapped.data;
+    }
+    else {
+        data_file.open(options.data_path);
+    }
 
-    return id + time + cars;
+    Prod_ThreadData<Record> prod = {};
+    prod.data_file = &data_file;
+    prod.cursor = use_mapping ? &cursor : nullptr;
+    prod.end = mapped.data + mapped.size;
+    prod.unpackable = &unpackable;
+
+    vector<Record> sample;
+    sample.reserve(WARMUP_RECORDS);
+
+    auto start = high_resolution_clock::now();
+    Record record;
+    while (sample.size() < WARMUP_RECORDS && nextRecord(&prod, record)) {
+        sample.push_back(record);
+    }
+    double produce_seconds = secondsSince(start);
+
+    // Stored in a throwaway store of the kind the consumers will fill (a
+    // spilling one is timed as buckets, since its writes are batched).
+    HourBucketsOf<Record> buckets;
+    TopNHeaps heaps;
+    RecordColumns columns;
+    HeavyHitterSketches sketches;
+    Cons_ThreadData<Record> cons = {};
+    if (options.store == "streaming") {
+        initTopNHeaps(heaps, N);
+        cons.heaps = &heaps;
+    }
+    else if (options.store == "columns") {
+        cons.columns = &columns;
+    }
+    else if (options.store == "sketch") {
+        initHeavyHitters(sketches, options.sketch_error);
+        cons.sketches = &sketches;
+    }
+    else {
+        cons.buckets = &buckets;
+    }
+
+    start = high_resolution_clock::now();
+    for (size_t i = 0; i < sample.size(); i++) {
+        storeRecord(&cons, sample[i]);
+    }
+    double consume_seconds = secondsSince(start);
+
+    if (use_mapping) {
+        unmapFile(mapped);
+    }
+
+    if (sample.empty()) {
+        return;
+    }
+
+    double produce_ns = produce_seconds * 1e9 / sample.size();
+    double consume_ns = consume_seconds * 1e9 / sample.size();
+    balanceThreads(produce_ns, consume_ns, options.threads, options.producers, options.consumers);
+
+    cerr << fixed << setprecision(1) << "Auto split: " << options.producers << " producers, "
+        << options.consumers << " consumers (parse " << produce_ns << " ns, store "
+        << consume_ns << " ns a record)\n";
 }
 
-int main(int argc, char *argv[]) {
-    ifstream data_file("./data");
-    queue<TrafficLightRecord> buffer;
-    vector<TrafficLightRecord> records;
+// Runs the producer and consumer threads over the data file, leaving each
+// consumer's records in buckets (or, when streaming, its top N records per
+// hour in heaps, or in columns, or written to the spill files, or counted in
+// sketches). The records consumed and lock wait go in stats. The spill
+// directory is left to spill_dir to remove.
+//
+// With --producers=auto the split is chosen by warmupSplit() first and left
+// in options.
+//
+// Returns false if the data file can't be mapped or spilling fails.
+template <typename Record>
+bool ingest(SimulatorOptions &options, int N, vector<HourBucketsOf<Record> > &buckets,
+                vector<TopNHeaps> &heaps, vector<RecordColumns> &columns,
+                vector<SpillPartitions> &spills, vector<HeavyHitterSketches> &sketches,
+                SpillDirGuard &spill_dir, RunStats &stats) {
+    if (options.auto_split) {
+        warmupSplit<Record>(options, N);
+    }
+
+    const int num_producers = options.producers;
+    const int num_consumers = options.consumers;
+
+    ifstream data_file;
+    MappedFile mapped = {nullptr, 0, -1};
+    const char *cursor = nullptr;
+
+    bool use_mapping = (options.input == "mmap" || options.input == "partitioned");
+    if (use_mapping) {
+        if (!mapFile(options.data_path.c_str(), mapped)) {
+            cerr << "Could not map " << options.data_path << "\n";
+            return false;
+        }
+        cursor = mapped.data;
+    }
+    else {
+        data_file.open(options.data_path);
+    }
+
+    // One newline aligned range of the file per producer.
+    vector<ByteRange> ranges;
+    if (options.input == "partitioned") {
+        ranges = splitLines(mapped, num_producers);
+    }
+
+    queue<Record> buffer;
+    bool streaming = (options.store == "streaming");
+    bool use_columns = (options.store == "columns");
+    bool use_spill = (options.store == "spill");
+    bool use_sketch = (options.store == "sketch");
+    buckets.assign((streaming || use_columns || use_spill || use_sketch) ? 0 : num_consumers,
+                    HourBucketsOf<Record>());
+    heaps.assign(streaming ? num_consumers : 0, TopNHeaps());
+    columns.assign(use_columns ? num_consumers : 0, RecordColumns());
+    spills.assign(use_spill ? num_consumers : 0, SpillPartitions());
+    sketches.assign(use_sketch ? num_consumers : 0, HeavyHitterSketches());
+
+    if (use_spill && !makeSpillDir(options.spill_dir, spill_dir.path)) {
+        cerr << "Could not create a spill directory in " << options.spill_dir << "\n";
+        return false;
+    }
+    spill_dir.num_writers = spills.size();
+
+    // The budget is shared between the consumers' buffers.
+    size_t spill_budget = static_cast<size_t>(options.memory_budget_mb) * 1024 * 1024
+                            / num_consumers;
+    for (int j = 0; j < static_cast<int>(spills.size()); j++) {
+        if (!initSpill(spills[j], spill_dir.path, j, spill_budget)) {
+            cerr << "Could not create the spill files in " << spill_dir.path << "\n";
+            for (int k = 0; k <= j; k++) {
+                closeSpill(spills[k]);
+            }
+            return false;
+        }
+    }
+    size_t expected_records = fileSize(options.data_path.c_str()) / 16;
 
     pthread_cond_t buff_has_task, buff_has_space;
     pthread_cond_init(&buff_has_task, nullptr);
@@ -245,46 +824,454 @@ int main(int argc, char *argv[]) {
     pthread_mutex_t m;
     pthread_mutex_init(&m, nullptr);
 
-    vector<pthread_t> tid(NUM_THREADS);
-    vector<Prod_ThreadData> prod_thread_data(NUM_THREADS / 2);
-    vector<Cons_ThreadData> cons_thread_data(NUM_THREADS - (NUM_THREADS / 2));
-    
+    QueueSignals signals;
+    initQueueSignals(signals, options.buffer_size);
+    QueueSignals *targeted = (options.wakeup == "targeted") ? &signals : nullptr;
+
+    bool use_ring = (options.channel == "ring");
+    RingBuffer<Record> ring;
+    atomic<int> producers_left(num_producers);
+    atomic<long> unpackable(0);
+    atomic<long long> lock_wait_ns(0);
+    if (use_ring) {
+        ringInit(ring, options.ring_size);
+    }
+
+    vector<pthread_t> tid(num_producers + num_consumers);
+    vector<Prod_ThreadData<Record> > prod_thread_data(num_producers);
+    vector<Cons_ThreadData<Record> > cons_thread_data(num_consumers);
+
 
-    for (int i = 0; i < NUM_THREADS / 2; i++) {
+    for (int i = 0; i < num_producers; i++) {
         prod_thread_data[i].buff_has_task = &buff_has_task;
         prod_thread_data[i].buff_has_space = &buff_has_space;
+        prod_thread_data[i].signals = targeted;
         prod_thread_data[i].buffer = &buffer;
+        prod_thread_data[i].buffer_size = options.buffer_size;
+        prod_thread_data[i].num_consumers = num_consumers;
+        prod_thread_data[i].lock_wait_ns = &lock_wait_ns;
         prod_thread_data[i].mutex = &m;
         prod_thread_data[i].data_file = &data_file;
+        prod_thread_data[i].cursor = (cursor != nullptr) ? &cursor : nullptr;
+        prod_thread_data[i].end = mapped.data + mapped.size;
+        prod_thread_data[i].ring = &ring;
+        prod_thread_data[i].producers_left = &producers_left;
+        prod_thread_data[i].unpackable = &unpackable;
+        prod_thread_data[i].own_range = !ranges.empty();
+        PIPELINE_COUNT(initCounters(prod_thread_data[i].counters, "producer"));
+
+        if (prod_thread_data[i].own_range) {
+            prod_thread_data[i].range_cursor = ranges[i].begin;
+            prod_thread_data[i].cursor = &prod_thread_data[i].range_cursor;
+            prod_thread_data[i].end = ranges[i].end;
+        }
 
-        pthread_create(&tid[i], nullptr, produce, &prod_thread_data[i]);
+        createPinnedThread(&tid[i], use_ring ? produceRing<Record> : produce<Record>,
+                            &prod_thread_data[i], threadCore(options.pin_cores, i));
     }
 
-    for (int i = NUM_THREADS / 2; i < NUM_THREADS; i++) {
-        int j = i - NUM_THREADS / 2;
+    for (int i = num_producers; i < num_producers + num_consumers; i++) {
+        int j = i - num_producers;
         cons_thread_data[j].buff_has_task = &buff_has_task;
         cons_thread_data[j].buff_has_space = &buff_has_space;
+        cons_thread_data[j].signals = targeted;
         cons_thread_data[j].buffer = &buffer;
+        cons_thread_data[j].buffer_size = options.buffer_size;
         cons_thread_data[j].mutex = &m;
-        cons_thread_data[j].records = &records;
+        cons_thread_data[j].ring = &ring;
+        cons_thread_data[j].buckets = nullptr;
+        cons_thread_data[j].heaps = nullptr;
+        cons_thread_data[j].columns = nullptr;
+        cons_thread_data[j].spill = nullptr;
+        cons_thread_data[j].sketches = nullptr;
+        cons_thread_data[j].lock_wait_ns = &lock_wait_ns;
+        cons_thread_data[j].records = 0;
+        PIPELINE_COUNT(initCounters(cons_thread_data[j].counters, "consumer"));
 
-        pthread_create(&tid[i], nullptr, consume, &cons_thread_data[j]);
+        if (streaming) {
+            initTopNHeaps(heaps[j], N);
+            cons_thread_data[j].heaps = &heaps[j];
+        }
+        else if (use_columns) {
+            reserveColumns(columns[j], expected_records / num_consumers);
+            cons_thread_data[j].columns = &columns[j];
+        }
+        else if (use_spill) {
+            cons_thread_data[j].spill = &spills[j];
+        }
+        else if (use_sketch) {
+            initHeavyHitters(sketches[j], options.sketch_error);
+            cons_thread_data[j].sketches = &sketches[j];
+        }
+        else {
+            // Lines are about 16 bytes, so this is roughly each consumer's
+            // share of the file and saves reallocating while consuming.
+            reserveBuckets(buckets[j], expected_records / num_consumers);
+            cons_thread_data[j].buckets = &buckets[j];
+        }
+
+        createPinnedThread(&tid[i], use_ring ? consumeRing<Record> : consume<Record>,
+                            &cons_thread_data[j], threadCore(options.pin_cores, i));
     }
 
-    for (int i = 0; i < NUM_THREADS; i++) {
+    for (int i = 0; i < num_producers + num_consumers; i++) {
         pthread_join(tid[i], nullptr);
     }
 
-    // atoi() converts an "Array of characters TO an Int".
-    int N = atoi(argv[1]), hr = atoi(argv[2]);
+    stats.records = 0;
+    for (int j = 0; j < num_consumers; j++) {
+        stats.records += cons_thread_data[j].records;
+    }
+    stats.lock_wait_seconds = lock_wait_ns / 1e9;
+    stats.producers = num_producers;
+    stats.consumers = num_consumers;
+
+#ifndef NO_PIPELINE_COUNTERS
+    if (options.counters) {
+        vector<ThreadCounters> counters;
+        for (int i = 0; i < num_producers; i++) {
+            counters.push_back(prod_thread_data[i].counters);
+        }
+        for (int j = 0; j < num_consumers; j++) {
+            counters.push_back(cons_thread_data[j].counters);
+        }
+
+        printCounterTable(cerr, counters);
+        printCountersJson(cerr, counters);
+    }
+#endif
+
+    if (use_ring) {
+        ringDestroy(ring);
+    }
+
+    if (use_mapping) {
+        unmapFile(mapped);
+    }
+    else {
+        data_file.close();
+    }
+
+    if (unpackable > 0) {
+        cerr << "Skipped " << unpackable << " records that don't fit a packed record\n";
+    }
+
+    bool spilled = true;
+    for (size_t j = 0; j < spills.size(); j++) {
+        spilled = closeSpill(spills[j]) && spilled;
+    }
+    if (!spilled) {
+        cerr << "Could not write the spill files in " << spill_dir.path << "\n";
+    }
+
+    return spilled;
+}
+
+// Answers a single hour query with answer() and prints the result. With
+// --stats the time since start (getting the data ready) and the time the
+// query took are printed too.
+template <typename Answer>
+void printQueryResult(const SimulatorOptions &options, RunStats &stats,
+                        high_resolution_clock::time_point start, int N, Answer answer) {
+    stats.ingest_seconds = secondsSince(start);
+
+    auto query_start = high_resolution_clock::now();
+    vector<TrafficLightRecord> congested_lights = answer();
+    stats.query_seconds = secondsSince(query_start);
+
+    printMostCongested(congested_lights, N, options.format);
+
+    if (options.stats) {
+        printRunStats(cerr, stats);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    SimulatorOptions options;
+
+    // Without N and hr the options start straight away, which is only
+    // allowed (and required) in batch and server mode.
+    bool no_query = (argc > 1 && string(argv[1]).compare(0, 2, "--") == 0);
+    bool valid = (no_query || argc >= 3)
+                    && parseOptions(argc, argv, no_query ? 1 : 3, options);
+
+    // The auto split picks both counts, so neither can be given with it.
+    valid = valid && !(options.auto_split && options.consumers != 0);
+    resolveThreads(options);
+
+    bool batch = !options.batch_path.empty();
+    bool serve = !options.socket_path.empty();
+    bool streaming = (options.store == "streaming");
+    bool packed = (options.record == "packed");
+    bool use_columns = (options.store == "columns");
+    bool use_spill = (options.store == "spill");
+    bool use_sketch = (options.store == "sketch");
+
+    // A range query has "HHMM-HHMM" in place of hr.
+    int start_slot = 0, end_slot = 0;
+    bool range = !no_query && argc >= 3 && string(argv[2]).find('-', 1) != string::npos;
+    if (range && !parseTimeRange(argv[2], start_slot, end_slot)) {
+        cerr << "Bad range " << argv[2] << ", expected HHMM-HHMM\n";
+        valid = false;
+    }
+
+    // An hour query's hr has to be an hour of the day, and N of any query
+    // has to be positive, as in a batch file.
+    bool bad_hour = !no_query && !range && argc >= 3
+                        && (atoi(argv[2]) < 0 || atoi(argv[2]) >= HOURS_PER_DAY);
+    bool bad_n = !no_query && argc >= 3 && atoi(argv[1]) < 1;
+
+    // The server and range queries need every record, not just each hour's
+    // top N. Following only works on a single hour query of a text file, as
+    // do packed records and the columns, spill and sketch stores. --stats
+    // and --format only apply to a single hour query of records.
+    if (!valid || bad_hour || bad_n || no_query != (batch || serve) || (batch && serve)
+            || (serve && streaming)
+            || (options.follow && (no_query || range || options.input == "binary"))
+            || (range && streaming) || (options.light != -1 && !range)
+            || (options.aggregate && (no_query || range || streaming || options.follow))
+            || (packed && (no_query || range || streaming || options.follow
+                            || options.aggregate || options.input == "binary"))
+            || ((use_columns || use_spill || use_sketch)
+                    && (no_query || range || packed || options.follow || options.aggregate
+                        || options.input == "binary"))
+            || ((options.stats || options.format != "human")
+                    && (no_query || range || options.follow || options.aggregate || use_sketch))) {
+        cerr << "Usage: " << argv[0] << " (N hr|HHMM-HHMM [--follow] [--light=id] [--aggregate]"
+            << " | --batch=path|- | --serve=socket)"
+            << " [--input=getline|mmap|partitioned|binary]"
+            << " [--data=path] [--channel=queue|ring] [--ring-size=n]"
+            << " [--store=index|streaming|columns|spill|sketch] [--spill-dir=path]"
+            << " [--memory-budget=MB] [--sketch-error=e] [--record=full|packed]"
+            << " [--threads=n] [--producers=n|auto] [--consumers=n] [--buffer-size=n]"
+            << " [--wakeup=targeted|broadcast]"
+            << " [--pin=spread|core,core,...] [--format=human|csv|jsonl] [--stats]"
+#ifndef NO_PIPELINE_COUNTERS
+            << " [--counters]"
+#endif
+            << "\n";
+        return EXIT_FAILURE;
+    }
+
+    vector<TrafficQuery> queries;
+    int N = 0, hr = 0;
+
+    if (batch) {
+        ifstream query_file;
+        if (options.batch_path != "-") {
+            query_file.open(options.batch_path);
+        }
+        istream &query_stream = (options.batch_path == "-") ? cin : query_file;
+
+        if (!query_stream || !readQueries(query_stream, queries)) {
+            cerr << "Could not read the queries in " << options.batch_path << "\n";
+            return EXIT_FAILURE;
+        }
+
+        // Streaming mode has to keep enough records for the largest query.
+        for (size_t i = 0; i < queries.size(); i++) {
+            N = max(N, queries[i].N);
+        }
+    }
+    else if (!serve) {
+        // atoi() converts an "Array of characters TO an Int".
+        N = atoi(argv[1]);
+        hr = atoi(argv[2]);
+    }
+
+    if (options.follow) {
+        bool followed = followFile(options.data_path, N, [&](const FollowState &state) {
+            vector<TrafficLightRecord> congested_lights = mostCongestion(state.heaps, hr, N);
+
+            cout << "After " << state.num_records << " records:\n\n";
+            printMostCongested(congested_lights, congested_lights.size());
+            cout << flush;
+        });
 
-    vector<TrafficLightRecord> congested_lights = mostCongestion(records, hr, N);
-    for (int i = congested_lights.size() - 1; i >= 0; i--) {
-        cout << "(" + to_string(N - i) + ")\n" 
-            << visualRecord(congested_lights[i]) << "\n\n";
+        return followed ? EXIT_SUCCESS : EXIT_FAILURE;
     }
 
-    data_file.close();
+    RunStats stats = {"pthread", 0, 0, 0, 0, 0, 0};
+    auto start = high_resolution_clock::now();
+
+    if (packed) {
+        // The same pipeline on 8 byte records, unpacked again for printing.
+        vector<HourBucketsOf<PackedRecord> > buckets;
+        vector<TopNHeaps> heaps;
+        vector<RecordColumns> columns;
+        vector<SpillPartitions> spills;
+        vector<HeavyHitterSketches> sketches;
+        SpillDirGuard spill_dir;
+        if (!ingest(options, N, buckets, heaps, columns, spills, sketches, spill_dir, stats)) {
+            return EXIT_FAILURE;
+        }
+
+        HourIndexOf<PackedRecord> packed_index;
+        buildHourIndex(buckets.data(), options.consumers, packed_index);
+
+        printQueryResult(options, stats, start, N, [&]() {
+            return unpackRecords(mostCongestion(packed_index, hr, N, options.threads));
+        });
+        return EXIT_SUCCESS;
+    }
+
+    HourIndex index;
+    TopNHeaps merged;
+
+    if (options.input == "binary") {
+        BinaryTrafficData binary_data;
+        if (!loadBinaryData(options.data_path.c_str(), binary_data)) {
+            cerr << options.data_path << " is not a binary data file\n";
+            return EXIT_FAILURE;
+        }
+
+        if (!batch && !serve && !range && !options.aggregate) {
+            // The binary format is already grouped by hour, so instead of
+            // ingesting the whole file only the requested hour's part of the
+            // mapping is read.
+            vector<TrafficLightRecord> hour_records = binaryHourRecords(binary_data, hr);
+            stats.records = hour_records.size();
+
+            // The records are all in hour hr already, so they only need
+            // ranking.
+            printQueryResult(options, stats, start, N, [&]() {
+                return topNRecords(hour_records, N);
+            });
+
+            unloadBinaryData(binary_data);
+            return EXIT_SUCCESS;
+        }
+
+        buildHourIndex(binary_data, index);
+        stats.records = index.records.size();
+        unloadBinaryData(binary_data);
+        streaming = false;
+    }
+    else {
+        vector<HourBuckets> buckets;
+        vector<TopNHeaps> heaps;
+        vector<RecordColumns> columns;
+        vector<SpillPartitions> spills;
+        vector<HeavyHitterSketches> sketches;
+        SpillDirGuard spill_dir;
+        if (!ingest(options, N, buckets, heaps, columns, spills, sketches, spill_dir, stats)) {
+            return EXIT_FAILURE;
+        }
+
+        if (use_columns) {
+            // Each consumer's columns are filtered where they are, with no
+            // index built.
+            printQueryResult(options, stats, start, N, [&]() {
+                return mostCongestion(columns.data(), options.consumers, hr, N);
+            });
+            return EXIT_SUCCESS;
+        }
+
+        if (use_spill) {
+            // Only hour hr's partitions are read back, through a heap of N.
+            bool read = true;
+            size_t budget = static_cast<size_t>(options.memory_budget_mb) * 1024 * 1024;
+            printQueryResult(options, stats, start, N, [&]() {
+                vector<TrafficLightRecord> congested_lights;
+                read = mostCongestionSpilled(spills[0].dir, options.consumers, hr, N, budget,
+                                                congested_lights);
+                return congested_lights;
+            });
+
+            if (!read) {
+                cerr << "Could not read the spill files in " << spills[0].dir << "\n";
+            }
+            return read ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+        if (use_sketch) {
+            // Each light is ranked by its estimated total, which is at most
+            // sketch_error of the hour's cars too high.
+            HeavyHitterSketches merged_sketches;
+            mergeHeavyHitters(sketches.data(), options.consumers, merged_sketches);
+
+            printLightTotals(mostCongestedSketch(merged_sketches, hr, N));
+            cerr << "Estimates are at most "
+                << static_cast<long long>(merged_sketches.hours[hr].total
+                                            / sketchCapacity(options.sketch_error))
+                << " cars above the real totals\n";
+            return EXIT_SUCCESS;
+        }
+
+        if (streaming) {
+            mergeTopNHeaps(heaps.data(), options.consumers, merged);
+        }
+        else {
+            buildHourIndex(buckets.data(), options.consumers, index);
+        }
+    }
+
+    if (range) {
+        // The running totals are built once from the index, then the query
+        // itself never looks at a record.
+        RangeSums sums;
+        buildRangeSums(index.records, sums);
+
+        if (options.light != -1) {
+            long long total;
+            if (!lightRangeTotal(sums, options.light, start_slot, end_slot, total)) {
+                cerr << "No light with ID " << options.light << "\n";
+                return EXIT_FAILURE;
+            }
+            cout << "ID: " << options.light << "\nCars Passed: " << total << "\n";
+        }
+        else {
+            printLightTotals(mostCongestedRange(sums, start_slot, end_slot, N));
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+    if (options.aggregate) {
+        // Every (id, hour) is totalled, then hour hr's totals are ranked.
+        vector<AggregateTable> partitions;
+        aggregateRecords(index.records, options.threads, partitions);
+
+        printLightTotals(mostCongestedAggregate(partitions, hr, N));
+        return EXIT_SUCCESS;
+    }
+
+    if (serve) {
+        rankHourIndex(index);
+        return runQueryServer(options.socket_path, index) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (batch) {
+        // Each queried hour is ranked once and all of its queries are
+        // answered from that.
+        vector<TrafficLightRecord> selections[HOURS_PER_DAY];
+
+        if (streaming) {
+            // The heaps are already down to N records, so this is cheap
+            // enough not to need threads.
+            int max_N[HOURS_PER_DAY];
+            maxNPerHour(queries, max_N);
+            for (int i = 0; i < HOURS_PER_DAY; i++) {
+                selections[i] = mostCongestion(merged, i, max_N[i]);
+            }
+        }
+        else {
+            selectQueriedHours(index, queries, options.threads, selections);
+        }
+
+        printQueryAnswers(queries, selections);
+    }
+    else if (streaming) {
+        printQueryResult(options, stats, start, N, [&]() {
+            return mostCongestion(merged, hr, N);
+        });
+    }
+    else {
+        // Only hour hr's partition of the index is read, by every thread.
+        printQueryResult(options, stats, start, N, [&]() {
+            return mostCongestion(index, hr, N, options.threads);
+        });
+    }
 
     return EXIT_SUCCESS;
 }